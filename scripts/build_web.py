@@ -0,0 +1,80 @@
+# Builds the dashboard in web/ into data/www/ for the LittleFS image.
+#
+# Every asset is stored gzip-compressed only (name.gz); ESPAsyncWebServer's
+# serveStatic finds the .gz file and sends it with Content-Encoding: gzip.
+# Assets under web/assets/ get the first 8 hex digits of their SHA-256 in the
+# file name and index.html is rewritten to reference them, so the server can
+# mark them immutable and a changed file is a new URL.
+#
+# Runs as a PlatformIO pre-script before buildfs/uploadfs:
+#   pio run -t uploadfs
+# or by hand:
+#   python scripts/build_web.py
+
+import gzip
+import hashlib
+import os
+import shutil
+
+HASH_LEN = 8
+
+
+def gzip_bytes(data):
+    # mtime 0 keeps the output reproducible for identical input
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def write(path, data):
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def build(project_dir):
+    src = os.path.join(project_dir, "web")
+    out = os.path.join(project_dir, "data", "www")
+    if os.path.isdir(out):
+        shutil.rmtree(out)
+
+    total = 0
+    renames = {}
+    assets = os.path.join(src, "assets")
+    for name in sorted(os.listdir(assets)) if os.path.isdir(assets) else []:
+        with open(os.path.join(assets, name), "rb") as f:
+            data = f.read()
+        stem, ext = os.path.splitext(name)
+        hashed = "%s.%s%s" % (stem, hashlib.sha256(data).hexdigest()[:HASH_LEN], ext)
+        renames["assets/" + name] = "assets/" + hashed
+        packed = gzip_bytes(data)
+        write(os.path.join(out, "assets", hashed + ".gz"), packed)
+        total += len(packed)
+        print("[web] assets/%s -> %s.gz (%d -> %d bytes)" % (name, hashed, len(data), len(packed)))
+
+    for name in sorted(os.listdir(src)):
+        path = os.path.join(src, name)
+        if not os.path.isfile(path):
+            continue
+        with open(path, "rb") as f:
+            data = f.read()
+        if name.endswith(".html"):
+            text = data.decode("utf-8")
+            for old, new in renames.items():
+                text = text.replace('"%s"' % old, '"%s"' % new)
+            data = text.encode("utf-8")
+        packed = gzip_bytes(data)
+        write(os.path.join(out, name + ".gz"), packed)
+        total += len(packed)
+        print("[web] %s.gz (%d -> %d bytes)" % (name, len(data), len(packed)))
+
+    print("[web] %d bytes in %s" % (total, out))
+
+
+try:
+    Import("env")  # noqa: F821, provided by PlatformIO
+except NameError:
+    env = None
+
+if env is None:
+    build(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+elif set(COMMAND_LINE_TARGETS) & {"buildfs", "uploadfs", "uploadfsota"}:  # noqa: F821
+    build(env.subst("$PROJECT_DIR"))
@@ -0,0 +1,86 @@
+#include "Calibration.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ArduinoJson.h>
+#include "hal/Hal.h"
+
+FlowCalibration::FlowCalibration() : pumpFlow(0)
+{
+  for (int i = 0; i < CALIBRATION_VALVES; i++)
+  {
+    valveFlow[i] = CALIBRATION_DEFAULT_FLOW;
+    measured[i] = false;
+  }
+}
+
+// flow_ml_per_s of one fitting, 0 when null, missing or nonsense
+static float fittingFlow(JsonVariantConst valve, const char *fitting)
+{
+  JsonVariantConst flow = valve[fitting]["flow_ml_per_s"];
+  if (!flow.is<float>())
+    return 0;
+  float f = flow.as<float>();
+  return f > 0 && f < 1000 ? f : 0;
+}
+
+bool loadCalibration(const char *path, FlowCalibration &cal)
+{
+  cal = FlowCalibration();
+
+  hal::File file;
+  if (!file.open(path, "r"))
+  {
+    hal::logf("[Calibration] %s not found, %.1f ml/s per valve, one valve at a time\n", path, CALIBRATION_DEFAULT_FLOW);
+    return false;
+  }
+  size_t size = file.size();
+  if (size == 0 || size > CALIBRATION_MAX_FILE)
+  {
+    hal::logf("[Calibration] %s has %u bytes, ignored\n", path, (unsigned)size);
+    return false;
+  }
+  char *text = (char *)malloc(size);
+  if (!text)
+    return false;
+  size_t n = file.read(text, size);
+  file.close();
+
+  JsonDocument doc;
+  DeserializationError err = deserializeJson(doc, text, n);
+  free(text);
+  if (err)
+  {
+    hal::logf("[Calibration] %s: %s, using defaults\n", path, err.c_str());
+    return false;
+  }
+
+  const char *fitting = doc["fitting"] | "with_dripper";
+  const char *other = strcmp(fitting, "with_dripper") == 0 ? "without_dripper" : "with_dripper";
+  for (int i = 0; i < CALIBRATION_VALVES; i++)
+  {
+    char key[4];
+    snprintf(key, sizeof(key), "%d", i);
+    JsonVariantConst valve = doc["valves"][key];
+    float flow = fittingFlow(valve, fitting);
+    if (!flow)
+    {
+      flow = fittingFlow(valve, other);
+      if (flow)
+        hal::logf("[Calibration] Valve %d: no %s measurement, using %s\n", i, fitting, other);
+    }
+    if (flow)
+    {
+      cal.valveFlow[i] = flow;
+      cal.measured[i] = true;
+    }
+  }
+
+  JsonVariantConst pump = doc["pump"]["max_flow_ml_per_s"];
+  if (pump.is<float>() && pump.as<float>() > 0)
+    cal.pumpFlow = pump.as<float>();
+
+  hal::logf("[Calibration] %s: %.2f / %.2f / %.2f / %.2f ml/s, pump %.2f ml/s\n", fitting,
+            cal.valveFlow[0], cal.valveFlow[1], cal.valveFlow[2], cal.valveFlow[3], cal.pumpFlow);
+  return true;
+}
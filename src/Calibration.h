@@ -0,0 +1,29 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Flow calibration of the valves, data/calibration.json on the filesystem.
+//
+// Per valve, "with_dripper" and "without_dripper" hold measured flow rates in
+// ml/s; "fitting" selects which one is installed, the other one is used when
+// the selected one has not been measured yet. "pump.max_flow_ml_per_s" is
+// what the pump delivers with several valves open; while it is unknown (null)
+// valves run one at a time. Missing files or values fall back to
+// CALIBRATION_DEFAULT_FLOW, the single valve rate of the current pump.
+
+#define CALIBRATION_PATH "/calibration.json"
+#define CALIBRATION_VALVES 4
+#define CALIBRATION_DEFAULT_FLOW 15.0f // ml/s through one valve
+#define CALIBRATION_MAX_FILE 4096
+
+struct FlowCalibration {
+    float valveFlow[CALIBRATION_VALVES]; // ml/s
+    bool measured[CALIBRATION_VALVES];   // false when valveFlow is the default
+    float pumpFlow;                      // ml/s with several valves open, 0 = one valve at a time
+
+    FlowCalibration();
+};
+
+// Reads path into cal, keeps defaults for anything missing. False if the file
+// is missing or malformed (cal then holds defaults only).
+bool loadCalibration(const char *path, FlowCalibration &cal);
@@ -1,11 +1,12 @@
-#include <Arduino.h>
-#include <Preferences.h>
+#include <string.h>
 #include <ArduinoJson.h>
 #include "ConfigManager.h"
+#include "Crc32.h"
+#include "hal/Hal.h"
 
-Preferences preferences;
+static hal::Nvs nvs;
 
-ConfigManager::ConfigManager() {
+ConfigData::ConfigData() {
   // Defaults (same as reset, but without saving to flash)
   mode = "Grow";
   lightStart = 23;
@@ -13,111 +14,271 @@ ConfigManager::ConfigManager() {
   sensorSettleTime = 300;
   soilLogIntervalMin = 15;
   soilSensorCounter = 10;
+  sensorGroupSize = 4;
   //wateringEnabled = true;
 
   setDefaultSchedules();
 }
 
-void ConfigManager::load() {
-    if (!preferences.begin("garden", true)) {
-        Serial.println("[Config] Failed to open NVS in read mode, using defaults");
-        setDefaultSchedules();
-        return;
+ConfigManager::ConfigManager() : current(std::make_shared<const ConfigData>()) {
+}
+
+void ConfigManager::publish(const ConfigData &next) {
+  std::shared_ptr<ConfigData> snapshot = std::make_shared<ConfigData>(next);
+  snapshot->version = get()->version + 1;
+  // readers still holding the previous snapshot keep it alive until they are done
+  std::atomic_store(&current, ConfigRef(snapshot));
+}
+
+// --- Binary layout in NVS ---
+// Two blobs, "cfgCore" (scalars) and "cfgSched" (schedule array), each
+// BlobHeader + payload. Fields are only ever appended to the records: an older
+// (shorter) payload loads into the defaults and keeps them for the new fields.
+#define CONFIG_MAGIC 0xC0F6
+#define CONFIG_BLOB_VERSION 1
+#define CONFIG_BLOB_MAX 512
+
+struct BlobHeader {
+    uint16_t magic;
+    uint16_t version; // CONFIG_BLOB_VERSION of the writer
+    uint16_t length;  // payload bytes
+    uint16_t reserved;
+    uint32_t crc;     // crc32 of payload
+};
+
+struct CoreRecord {
+    char mode[CONFIG_MODE_LEN];
+    int32_t lightStart;
+    int32_t lightEnd;
+    int32_t sensorSettleTime;
+    int32_t soilLogIntervalMin;
+    int32_t soilSensorCounter;
+    int32_t sensorGroupSize;
+};
+
+struct ScheduleRecord {
+    char time[5]; // "HH:MM", not terminated
+    uint8_t reserved;
+    uint16_t durations[4];
+};
+
+// Reads a blob, returns payload length or -1 if missing or corrupt
+static int readBlob(const char *key, void *payload, size_t maxLen)
+{
+  uint8_t buf[CONFIG_BLOB_MAX];
+  size_t len = nvs.getBytes(key, buf, sizeof(buf));
+  BlobHeader header;
+  if (len < sizeof(header))
+    return -1;
+  memcpy(&header, buf, sizeof(header));
+  if (header.magic != CONFIG_MAGIC || header.length != len - sizeof(header) ||
+      crc32(buf + sizeof(header), header.length) != header.crc)
+  {
+    hal::logf("[Config] %s is corrupt, ignoring\n", key);
+    return -1;
+  }
+  size_t n = header.length < maxLen ? header.length : maxLen;
+  memcpy(payload, buf + sizeof(header), n);
+  return header.length;
+}
+
+// Writes a blob only if it differs from what is stored, changed tells whether it was written.
+// Returns false unless the stored blob reads back equal to payload.
+static bool writeBlob(const char *key, const void *payload, size_t len, bool &changed)
+{
+  changed = false;
+  uint8_t buf[CONFIG_BLOB_MAX];
+  BlobHeader header = {CONFIG_MAGIC, CONFIG_BLOB_VERSION, (uint16_t)len, 0, crc32(payload, len)};
+  memcpy(buf, &header, sizeof(header));
+  memcpy(buf + sizeof(header), payload, len);
+
+  // reads do not wear flash, unchanged sections are skipped
+  uint8_t stored[CONFIG_BLOB_MAX];
+  size_t total = sizeof(header) + len;
+  if (nvs.getBytesLength(key) == total && nvs.getBytes(key, stored, sizeof(stored)) == total && memcmp(stored, buf, total) == 0)
+    return true;
+  changed = true;
+  if (!nvs.putBytes(key, buf, total) ||
+      nvs.getBytes(key, stored, sizeof(stored)) != total || memcmp(stored, buf, total) != 0)
+  {
+    hal::logf("[Config] Failed to write %s\n", key);
+    return false;
+  }
+  return true;
+}
+
+bool ConfigManager::loadBlobs(ConfigData &c) {
+    CoreRecord core;
+    memset(&core, 0, sizeof(core));
+    strncpy(core.mode, c.mode.c_str(), sizeof(core.mode) - 1);
+    core.lightStart = c.lightStart;
+    core.lightEnd = c.lightEnd;
+    core.sensorSettleTime = c.sensorSettleTime;
+    core.soilLogIntervalMin = c.soilLogIntervalMin;
+    core.soilSensorCounter = c.soilSensorCounter;
+    core.sensorGroupSize = c.sensorGroupSize;
+    if (readBlob("cfgCore", &core, sizeof(core)) < 0)
+        return false;
+
+    core.mode[sizeof(core.mode) - 1] = '\0';
+    c.mode = core.mode;
+    c.lightStart = core.lightStart;
+    c.lightEnd = core.lightEnd;
+    c.sensorSettleTime = core.sensorSettleTime;
+    c.soilLogIntervalMin = core.soilLogIntervalMin;
+    c.soilSensorCounter = core.soilSensorCounter;
+    c.sensorGroupSize = core.sensorGroupSize;
+
+    ScheduleRecord records[CONFIG_MAX_SCHEDULES];
+    int len = readBlob("cfgSched", records, sizeof(records));
+    if (len < 0) {
+        hal::logf("[Config] Watering schedules missing, using defaults\n");
+        c.setDefaultSchedules();
+        return true;
+    }
+    c.wateringSchedules.clear();
+    for (size_t i = 0; i < (size_t)len / sizeof(ScheduleRecord) && i < CONFIG_MAX_SCHEDULES; i++) {
+        WateringSchedule ws;
+        ws.time.assign(records[i].time, sizeof(records[i].time));
+        for (int v = 0; v < 4; v++)
+            ws.durations[v] = records[i].durations[v];
+        c.wateringSchedules.push_back(ws);
     }
+    return true;
+}
 
-    mode = preferences.getString("mode", "growing");
-    lightStart = preferences.getInt("lightStart", 23);
-    lightEnd = preferences.getInt("lightEnd", 17);
-    sensorSettleTime = preferences.getInt("snsTime", 300);
-    soilLogIntervalMin = preferences.getInt("soilIntrvl", 15);
-    soilSensorCounter = preferences.getInt("soilSnsCnt", 5);
+// Config written before the binary format: one key per field, schedules as JSON
+static const char *legacyKeys[] = {"mode", "lightStart", "lightEnd", "snsTime", "soilIntrvl", "soilSnsCnt", "snsGroup", "wSchdl"};
 
-    wateringSchedules.clear();
-    if (preferences.isKey("wSchdl")) {
-        String schedulesJson = preferences.getString("wSchdl", "");
+void ConfigManager::loadLegacy(ConfigData &c) {
+    c.mode = nvs.getString("mode", "growing");
+    c.lightStart = nvs.getInt("lightStart", 23);
+    c.lightEnd = nvs.getInt("lightEnd", 17);
+    c.sensorSettleTime = nvs.getInt("snsTime", 300);
+    c.soilLogIntervalMin = nvs.getInt("soilIntrvl", 15);
+    c.soilSensorCounter = nvs.getInt("soilSnsCnt", 5);
+    c.sensorGroupSize = nvs.getInt("snsGroup", 4);
+
+    c.wateringSchedules.clear();
+    if (nvs.isKey("wSchdl")) {
+        std::string schedulesJson = nvs.getString("wSchdl", "");
         if (schedulesJson.length() > 0) {
             JsonDocument doc;
             DeserializationError err = deserializeJson(doc, schedulesJson);
             if (!err && doc.is<JsonArray>()) {
                 for (JsonObject obj : doc.as<JsonArray>()) {
                     WateringSchedule ws;
-                    ws.time = obj["time"].as<String>();
+                    ws.time = obj["time"] | "";
                     JsonArray arr = obj["durations"].as<JsonArray>();
                     for (int i = 0; i < 4; i++) {
                         ws.durations[i] = arr[i].as<int>();
                     }
-                    wateringSchedules.push_back(ws);
+                    c.wateringSchedules.push_back(ws);
                 }
-                Serial.printf("[Config] Loaded %d watering schedules from NVS\n", wateringSchedules.size());
+                hal::logf("[Config] Loaded %u watering schedules from NVS\n", (unsigned)c.wateringSchedules.size());
             } else {
-                Serial.println("[Config] Failed to parse wateringSchedules, using defaults");
-                setDefaultSchedules();
+                hal::logf("[Config] Failed to parse wateringSchedules, using defaults\n");
+                c.setDefaultSchedules();
             }
         } else {
-            Serial.println("[Config] wateringSchedules key empty, using defaults");
-            setDefaultSchedules();
+            hal::logf("[Config] wateringSchedules key empty, using defaults\n");
+            c.setDefaultSchedules();
         }
     } else {
-        Serial.println("[Config] wateringSchedules key not found in NVS, using defaults");
-        setDefaultSchedules();
+        hal::logf("[Config] wateringSchedules key not found in NVS, using defaults\n");
+        c.setDefaultSchedules();
+    }
+}
+
+void ConfigManager::load() {
+    ConfigData next;
+    if (!nvs.begin("garden", true)) {
+        hal::logf("[Config] Failed to open NVS in read mode, using defaults\n");
+        publish(next);
+        return;
     }
 
-    preferences.end();
+    // single blob read on every boot after the first one
+    bool migrate = false;
+    if (!loadBlobs(next)) {
+        migrate = nvs.isKey("lightStart");
+        loadLegacy(next);
+    }
+    nvs.end();
+    publish(next);
+
+    if (migrate) {
+        hal::logf("[Config] Migrating NVS keys to binary config\n");
+        // the legacy keys are the only copy until every blob is on flash
+        if (!save()) {
+            hal::logf("[Config] Migration failed, keeping NVS keys\n");
+            return;
+        }
+        if (nvs.begin("garden", false)) {
+            for (const char *key : legacyKeys)
+                nvs.remove(key);
+            nvs.end();
+        }
+    }
 }
 
-void ConfigManager::save() {
-  if (!preferences.begin("garden", false)) {
-      Serial.println("[Config] Failed to open NVS in write mode, cannot save");
-      return;
+bool ConfigManager::save() {
+  if (!nvs.begin("garden", false)) {
+      hal::logf("[Config] Failed to open NVS in write mode, cannot save\n");
+      return false;
   }
 
-  preferences.putString("mode", mode);
-  preferences.putInt("lightStart", lightStart);
-  preferences.putInt("lightEnd", lightEnd);
-  preferences.putInt("snsTime", sensorSettleTime);
-  preferences.putInt("soilIntrvl", soilLogIntervalMin);
-  preferences.putInt("soilSnsCnt", soilSensorCounter);
-
-  // Serialize wateringSchedules as JSON
-  JsonDocument doc;
-  JsonArray arr = doc.to<JsonArray>();
-  for (auto &ws : wateringSchedules) {
-    JsonObject obj = arr.add<JsonObject>();
-    obj["time"] = ws.time;
-    JsonArray d = obj["durations"].to<JsonArray>();
-    for (int v = 0; v < 4; v++) d.add(ws.durations[v]);
+  ConfigRef c = get();
+  CoreRecord core;
+  memset(&core, 0, sizeof(core));
+  strncpy(core.mode, c->mode.c_str(), sizeof(core.mode) - 1);
+  core.lightStart = c->lightStart;
+  core.lightEnd = c->lightEnd;
+  core.sensorSettleTime = c->sensorSettleTime;
+  core.soilLogIntervalMin = c->soilLogIntervalMin;
+  core.soilSensorCounter = c->soilSensorCounter;
+  core.sensorGroupSize = c->sensorGroupSize;
+
+  ScheduleRecord records[CONFIG_MAX_SCHEDULES];
+  memset(records, 0, sizeof(records));
+  size_t count = c->wateringSchedules.size() < CONFIG_MAX_SCHEDULES ? c->wateringSchedules.size() : CONFIG_MAX_SCHEDULES;
+  for (size_t i = 0; i < count; i++) {
+    const WateringSchedule &ws = c->wateringSchedules[i];
+    memcpy(records[i].time, ws.time.c_str(), ws.time.size() < 5 ? ws.time.size() : 5);
+    for (int v = 0; v < 4; v++)
+      records[i].durations[v] = ws.durations[v];
   }
-  String json;
-  serializeJson(doc, json);
-  preferences.putString("wSchdl", json);
 
-  preferences.end();
+  // each section is only rewritten when its bytes changed
+  bool coreChanged, schedChanged;
+  bool ok = writeBlob("cfgCore", &core, sizeof(core), coreChanged);
+  ok = writeBlob("cfgSched", records, count * sizeof(ScheduleRecord), schedChanged) && ok;
+  if (ok)
+    hal::logf("[Config] Saved, %d of 2 sections changed\n", (int)coreChanged + (int)schedChanged);
+
+  nvs.end();
+  return ok;
 }
 
 void ConfigManager::reset() {
-  if (!preferences.begin("garden", false)) {
-      Serial.println("[Config] Failed to open NVS in write mode, cannot reset");
+  if (!nvs.begin("garden", false)) {
+      hal::logf("[Config] Failed to open NVS in write mode, cannot reset\n");
       return;
   }
-  preferences.clear();
+  nvs.clear();
+  nvs.end();
 
   // Restore defaults
-  mode = "growing";
-  lightStart = 23;
-  lightEnd = 17;
-  sensorSettleTime = 300;
-  soilLogIntervalMin = 15;
-  soilSensorCounter = 10;
-  
-  //wateringEnabled = true;
+  ConfigData defaults;
+  defaults.mode = "growing";
 
-  setDefaultSchedules();
+  //wateringEnabled = true;
 
+  publish(defaults);
   save();
-  preferences.end();
 }
 
-void ConfigManager::setDefaultSchedules() {
+void ConfigData::setDefaultSchedules() {
     wateringSchedules.clear();
     wateringSchedules.push_back({"23:05", {45, 45, 45, 45}});
     wateringSchedules.push_back({"05:05", {30, 35, 30, 30}});
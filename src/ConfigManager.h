@@ -1,29 +1,68 @@
 #pragma once
-#include <vector>       // make sure STL vector is seen first
-#include <Arduino.h>    // defines String and other Arduino types
-#include <Preferences.h>
+#include <stdint.h>
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define CONFIG_MAX_SCHEDULES 24 // watering schedules persisted to NVS
+#define CONFIG_MODE_LEN 16      // mode string buffer, including terminator
 
 struct WateringSchedule {
-    String time;                 // "HH:MM"
+    std::string time;            // "HH:MM"
     std::array<int, 4> durations; // per-valve durations
 };
 
-class ConfigManager {
-public:
-    ConfigManager();
-
-    void load();
-    void save();
-    void reset();
+// One immutable version of the settings
+struct ConfigData {
+    ConfigData();
     void setDefaultSchedules();
 
     // --- Configurable values ---
-    String mode;
+    std::string mode;
     int lightStart;
     int lightEnd;
     int sensorSettleTime;
     int soilLogIntervalMin;
     int soilSensorCounter; // amuont of readings to average per sensor
+    int sensorGroupSize;   // sensors powered and sampled together (1 = one by one), limited by supply current
 
     std::vector<WateringSchedule> wateringSchedules;
-};
\ No newline at end of file
+
+    uint32_t version = 0; // set by ConfigManager::publish()
+};
+
+typedef std::shared_ptr<const ConfigData> ConfigRef;
+
+// Config is published as immutable, reference-counted snapshots (RCU style).
+// Readers on any core take get() once and use that snapshot for a whole pass,
+// without locks; a snapshot stays valid as long as someone holds it, so a
+// concurrent update never invalidates a reader's loop. Writers copy get(),
+// modify the copy and publish() it. Writers run on the AsyncTCP task (and
+// setup() before that), so there is only ever one at a time.
+//
+// Config is persisted in NVS as versioned, CRC-protected binary records
+// (see ConfigManager.cpp), written only when their content changed.
+// Config saved by older firmware (one key per field) is migrated on first load.
+class ConfigManager {
+public:
+    ConfigManager();
+
+    void load();
+    // false if NVS could not be opened or a record did not read back as written
+    bool save();
+    void reset();
+
+    // Current snapshot
+    ConfigRef get() const { return std::atomic_load(&current); }
+    // Replaces the current snapshot, bumping the version
+    void publish(const ConfigData &next);
+
+    // Bumped on every change, lets readers cache anything derived from config
+    uint32_t getVersion() const { return get()->version; }
+
+private:
+    static bool loadBlobs(ConfigData &c);  // false if there is no valid binary config
+    static void loadLegacy(ConfigData &c); // per-key config of older firmware, or defaults
+    ConfigRef current; // only accessed through std::atomic_load / std::atomic_store
+};
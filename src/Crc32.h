@@ -0,0 +1,6 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, same as zlib). Pass previous result as crc to continue a running checksum.
+uint32_t crc32(const void *data, size_t len, uint32_t crc = 0);
@@ -0,0 +1,25 @@
+#pragma once
+#include <time.h>
+#include <stdint.h>
+
+typedef enum
+{
+  EVENT_UNKNOWN,         //!< Event reason can not be determined
+  EVENT_SOIL_READINGS_0, //!< Soil humidity reading on sensor 0
+  EVENT_SOIL_READINGS_1, //!< Soil humidity reading on sensor 1
+  EVENT_SOIL_READINGS_2, //!< Soil humidity reading on sensor 2
+  EVENT_SOIL_READINGS_3, //!< Soil humidity reading on sensor 3
+  EVENT_WATERING_0,      //!< Watering event on valve 0
+  EVENT_WATERING_1,      //!< Watering event on valve 1
+  EVENT_WATERING_2,      //!< Watering event on valve 2
+  EVENT_WATERING_3       //!< Watering event on valve 3
+} event_type_t;
+
+#define EVENT_TYPE_COUNT (EVENT_WATERING_3 + 1)
+
+struct Event
+{
+  time_t timestamp;
+  event_type_t eventType; //!< Event type
+  uint16_t value;          //!< Depending on event type: soil humidity (1-4096) or watering duration (s)
+};
@@ -0,0 +1,206 @@
+#include "EventJournal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "Crc32.h"
+
+EventJournal::EventJournal()
+    : pendingCount(0), oldestPendingMs(0), dropped(0), ready(false), firstSegment(0), currentSegment(0), currentSize(0)
+{
+}
+
+std::string EventJournal::segmentPath(uint32_t segment) const
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), JOURNAL_DIR "/%08u.log", (unsigned)segment);
+  return buf;
+}
+
+bool EventJournal::begin()
+{
+  if (!hal::fsMount())
+  {
+    hal::logf("[Journal] Failed to mount LittleFS, events will not survive reboot\n");
+    return false;
+  }
+  if (!hal::fsExists(JOURNAL_DIR))
+    hal::fsMkdir(JOURNAL_DIR);
+
+  bool found = false;
+  uint32_t lo = 0, hi = 0;
+  hal::fsList(JOURNAL_DIR, [&](const char *name)
+              {
+                char *end;
+                uint32_t n = strtoul(name, &end, 10);
+                if (strcmp(end, ".log") != 0)
+                  return;
+                if (!found || n < lo)
+                  lo = n;
+                if (!found || n > hi)
+                  hi = n;
+                found = true; });
+
+  firstSegment = found ? lo : 0;
+  // never append after a tail that may be torn, replay() resumes the last segment if it is intact
+  currentSegment = found ? hi + 1 : 0;
+  currentSize = 0;
+  ready = true;
+  hal::logf("[Journal] %u segments on flash\n", found ? (unsigned)(hi - lo + 1) : 0);
+  return true;
+}
+
+size_t EventJournal::replaySegment(uint32_t segment, const std::function<void(const Event &)> &sink, size_t &validBytes, bool &clean)
+{
+  validBytes = 0;
+  clean = false;
+  hal::File f;
+  if (!f.open(segmentPath(segment).c_str(), "r"))
+    return 0;
+
+  size_t fileSize = f.size();
+  size_t replayed = 0;
+  Record records[JOURNAL_BATCH];
+  RecordHeader header;
+  while (f.read(&header, sizeof(header)) == sizeof(header))
+  {
+    if (header.magic != MAGIC || header.count == 0 || header.count > JOURNAL_BATCH)
+      break;
+    size_t bytes = header.count * sizeof(Record);
+    if (f.read(records, bytes) != bytes || crc32(records, bytes) != header.crc)
+    {
+      hal::logf("[Journal] Segment %u: torn record, ignoring rest\n", (unsigned)segment);
+      break;
+    }
+    for (size_t i = 0; i < header.count; i++)
+    {
+      Event event;
+      event.timestamp = records[i].time;
+      event.eventType = (event_type_t)records[i].type;
+      event.value = records[i].value;
+      sink(event);
+    }
+    replayed += header.count;
+    validBytes += sizeof(header) + bytes;
+  }
+  clean = validBytes == fileSize;
+  f.close();
+  return replayed;
+}
+
+size_t EventJournal::replay(const std::function<void(const Event &)> &sink)
+{
+  if (!ready)
+    return 0;
+  size_t replayed = 0;
+  uint32_t end = currentSegment;
+  for (uint32_t s = firstSegment; s != end; s++)
+  {
+    size_t validBytes;
+    bool clean;
+    replayed += replaySegment(s, sink, validBytes, clean);
+    if (s + 1 == end && clean && validBytes < JOURNAL_SEGMENT_SIZE)
+    {
+      // last segment ends on a record boundary, keep appending to it
+      currentSegment = s;
+      currentSize = validBytes;
+    }
+  }
+  return replayed;
+}
+
+void EventJournal::record(const Event &event)
+{
+  if (!ready)
+    return;
+  if (mutex.lock())
+  {
+    if (pendingCount < JOURNAL_PENDING)
+    {
+      if (pendingCount == 0)
+        oldestPendingMs = hal::uptimeMs();
+      Record &r = pending[pendingCount++];
+      r.time = (uint32_t)event.timestamp;
+      r.type = (uint8_t)event.eventType;
+      r.reserved = 0;
+      r.value = event.value;
+    }
+    else
+    {
+      dropped++;
+    }
+    mutex.unlock();
+  }
+}
+
+bool EventJournal::writeBatch(const Record *records, size_t count)
+{
+  size_t bytes = sizeof(RecordHeader) + count * sizeof(Record);
+  if (currentSize > 0 && currentSize + bytes > JOURNAL_SEGMENT_SIZE)
+  {
+    currentSegment++;
+    currentSize = 0;
+  }
+  if (currentSize == 0)
+  {
+    // recycle oldest segments before starting a new one
+    while (currentSegment - firstSegment >= JOURNAL_MAX_SEGMENTS)
+    {
+      hal::fsRemove(segmentPath(firstSegment).c_str());
+      firstSegment++;
+    }
+  }
+
+  hal::File f;
+  if (!f.open(segmentPath(currentSegment).c_str(), "a"))
+    return false;
+  RecordHeader header = {MAGIC, (uint16_t)count, crc32(records, count * sizeof(Record))};
+  size_t written = f.write(&header, sizeof(header));
+  written += f.write(records, count * sizeof(Record));
+  f.close();
+  if (written != bytes)
+  {
+    // a torn record ends replay of its segment, later batches go to a fresh one
+    currentSegment++;
+    currentSize = 0;
+    return false;
+  }
+  currentSize += written;
+  return true;
+}
+
+void EventJournal::sync(bool force)
+{
+  if (!ready)
+    return;
+  if (ioMutex.lock())
+  {
+    Record batch[JOURNAL_PENDING];
+    size_t n = 0;
+    if (mutex.lock())
+    {
+      if (pendingCount > 0 && (force || pendingCount >= JOURNAL_BATCH || hal::uptimeMs() - oldestPendingMs >= JOURNAL_FLUSH_MS))
+      {
+        // take everything and release the lock before touching flash
+        n = pendingCount;
+        memcpy(batch, pending, n * sizeof(Record));
+        pendingCount = 0;
+      }
+      mutex.unlock();
+    }
+    for (size_t i = 0; i < n; i += JOURNAL_BATCH)
+    {
+      size_t count = std::min((size_t)JOURNAL_BATCH, n - i);
+      if (!writeBatch(batch + i, count))
+      {
+        hal::logf("[Journal] Failed to write batch\n");
+        if (mutex.lock())
+        {
+          dropped += count; // not retried, newer events keep coming
+          mutex.unlock();
+        }
+      }
+    }
+    ioMutex.unlock();
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include "Event.h"
+#include "hal/Hal.h"
+
+// Append-only event journal on LittleFS, survives reboots.
+//
+// Events are collected in RAM and written out in batches, so flash is not
+// touched on every reading. Each batch is a record:
+//   uint16 magic, uint16 count, uint32 crc32(payload), count * 8 byte events
+// Records are appended to numbered segment files under /journal. A new
+// segment is started when the current one is full, or at boot when the last
+// one does not end cleanly; the oldest segment is deleted when there are more
+// than JOURNAL_MAX_SEGMENTS. Replay stops a segment at the first truncated or
+// corrupt record, so a power cut in the middle of a write loses at most that
+// batch. Journal size is bounded, which bounds recovery time.
+
+#define JOURNAL_DIR "/journal"
+#define JOURNAL_SEGMENT_SIZE 16384  // bytes per segment file
+#define JOURNAL_MAX_SEGMENTS 16     // 256 KB of flash, ~32k events
+#define JOURNAL_BATCH 32            // events per flash write
+#define JOURNAL_PENDING 64          // RAM buffer, events beyond it are not journaled
+#define JOURNAL_FLUSH_MS (5 * 60 * 1000) // max age of unwritten events
+
+class EventJournal {
+public:
+    EventJournal();
+
+    // Mounts LittleFS and scans segments. Returns false if journaling is unavailable.
+    bool begin();
+    // Feeds every valid journaled event to sink, oldest first
+    size_t replay(const std::function<void(const Event &)> &sink);
+
+    // Queues event for the next flush, cheap, never touches flash
+    void record(const Event &event);
+    // Writes pending events if a batch is full, they are old enough, or force is set.
+    // Call periodically from a task that may block on flash.
+    void sync(bool force = false);
+
+    uint32_t droppedCount() const { return dropped; }
+    hal::MutexStats getMutexStats() { return mutex.getStats(); }
+    hal::MutexStats getIoMutexStats() { return ioMutex.getStats(); }
+
+private:
+    struct Record {
+        uint32_t time;
+        uint8_t type;
+        uint8_t reserved;
+        uint16_t value;
+    };
+    struct RecordHeader {
+        uint16_t magic;
+        uint16_t count;
+        uint32_t crc;
+    };
+    static constexpr uint16_t MAGIC = 0xEB07;
+
+    std::string segmentPath(uint32_t segment) const;
+    bool writeBatch(const Record *records, size_t count);
+    size_t replaySegment(uint32_t segment, const std::function<void(const Event &)> &sink, size_t &validBytes, bool &clean);
+
+    hal::Mutex mutex;                 // guards pending, never held during flash I/O
+    hal::Mutex ioMutex;               // serializes segment writes
+    Record pending[JOURNAL_PENDING];
+    size_t pendingCount;
+    uint32_t oldestPendingMs;         // uptime when first pending event was queued
+    uint32_t dropped;                 // pending buffer full or batch write failed
+
+    bool ready;
+    uint32_t firstSegment;            // oldest segment on flash
+    uint32_t currentSegment;          // segment being appended to
+    size_t currentSize;               // bytes in current segment
+};
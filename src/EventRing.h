@@ -0,0 +1,135 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include "Event.h"
+
+// Lock-free multi-producer staging ring in front of EventStore.
+//
+// Producers claim a position with one fetch_add and publish the slot with a
+// per-slot sequence stamp (seqlock), so they never wait on each other or on
+// readers. A single consumer (LogManager, under its mutex) drains positions
+// in order; slots that were overwritten by a producer lapping the ring, or
+// changed while being copied, are detected by their stamp and counted as
+// dropped instead of being returned torn.
+//
+// The stamp holds the slot's latest position and a state. Only one producer
+// writes a slot at a time: a producer that laps a slot still being written
+// does not touch the payload, it marks the slot busy under its own position
+// and its event is dropped. The producer that was lapped then fails to
+// publish and frees the slot, so every position ends up either published or
+// dropped, and a stamp never vouches for another producer's payload.
+
+#define LOG_STAGING_SLOTS 64 // must be a power of two
+
+class EventRing {
+public:
+    EventRing() : head(0), tail(0), dropped(0)
+    {
+        for (Slot &s : slots)
+            s.stamp.store(0, std::memory_order_relaxed);
+    }
+
+    // Any task, any core, never blocks
+    void push(const Event &event)
+    {
+        uint32_t pos = head.fetch_add(1, std::memory_order_relaxed);
+        Slot &s = slots[pos & MASK];
+        uint32_t base = stampBase(pos);
+        uint32_t cur = s.stamp.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            if ((int32_t)((cur & ~STATE_MASK) - base) >= 0)
+                return; // lapped before we got here, a newer position owns the slot
+            uint32_t state = cur & STATE_MASK;
+            uint32_t next = base | (state == WRITING || state == BUSY ? BUSY : WRITING);
+            // acquire: our payload stores land after those of the slot's previous writer
+            if (s.stamp.compare_exchange_weak(cur, next, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                if (next != (base | WRITING))
+                    return; // an older producer is still writing, leave the payload to it
+                break;
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        s.time.store((uint32_t)event.timestamp, std::memory_order_relaxed);
+        s.data.store(((uint32_t)event.eventType << 16) | event.value, std::memory_order_relaxed);
+        cur = base | WRITING;
+        if (s.stamp.compare_exchange_strong(cur, base | PUBLISHED, std::memory_order_release, std::memory_order_relaxed))
+            return;
+        // lapped while writing: the slot is marked busy under a newer position,
+        // free it for the next producer (only other lappers move it meanwhile)
+        while (!s.stamp.compare_exchange_weak(cur, (cur & ~STATE_MASK) | FREE,
+                                              std::memory_order_release, std::memory_order_relaxed))
+            ;
+    }
+
+    // Single consumer: passes staged events to sink in order, returns number delivered.
+    // Stops at a slot whose producer has not finished yet, it is picked up next time.
+    template <typename Sink>
+    size_t drain(Sink sink)
+    {
+        uint32_t end = head.load(std::memory_order_acquire);
+        if (end - tail > LOG_STAGING_SLOTS)
+        {
+            // producers lapped the consumer, oldest positions are gone
+            dropped.fetch_add(end - tail - LOG_STAGING_SLOTS, std::memory_order_relaxed);
+            tail = end - LOG_STAGING_SLOTS;
+        }
+
+        size_t delivered = 0;
+        while (tail != end)
+        {
+            Slot &s = slots[tail & MASK];
+            uint32_t want = stampBase(tail);
+            uint32_t s1 = s.stamp.load(std::memory_order_acquire);
+            int32_t age = (int32_t)((s1 & ~STATE_MASK) - want);
+            if (age < 0 || (age == 0 && (s1 & STATE_MASK) == WRITING))
+                break; // claimed but not published yet
+            if (s1 == (want | PUBLISHED))
+            {
+                Event event;
+                event.timestamp = s.time.load(std::memory_order_relaxed);
+                uint32_t data = s.data.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s.stamp.load(std::memory_order_relaxed) == s1)
+                {
+                    event.eventType = (event_type_t)(data >> 16);
+                    event.value = (uint16_t)data;
+                    sink(event);
+                    delivered++;
+                    tail++;
+                    continue;
+                }
+            }
+            // overwritten before or while we copied it, or never written
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            tail++;
+        }
+        return delivered;
+    }
+
+    uint32_t pushedCount() const { return head.load(std::memory_order_relaxed); }
+    uint32_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint32_t MASK = LOG_STAGING_SLOTS - 1;
+
+    // stamp = (pos + 1) * 4 | state, 0 before the first write
+    static constexpr uint32_t STATE_MASK = 3;
+    static constexpr uint32_t FREE = 0;      // pos dropped, slot can be claimed
+    static constexpr uint32_t WRITING = 1;   // producer of pos is writing
+    static constexpr uint32_t PUBLISHED = 2; // pos readable
+    static constexpr uint32_t BUSY = 3;      // pos dropped, a lapped producer is still writing
+    static uint32_t stampBase(uint32_t pos) { return (pos + 1) << 2; }
+
+    struct Slot {
+        std::atomic<uint32_t> stamp; // see stampBase() and the states above
+        std::atomic<uint32_t> time;
+        std::atomic<uint32_t> data;  // type << 16 | value
+    };
+
+    Slot slots[LOG_STAGING_SLOTS];
+    std::atomic<uint32_t> head;    // next position to claim
+    uint32_t tail;                 // next position to drain, consumer only
+    std::atomic<uint32_t> dropped;
+};
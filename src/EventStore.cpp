@@ -0,0 +1,240 @@
+#include "EventStore.h"
+#include <stdlib.h>
+#include <string.h>
+#include "hal/Hal.h"
+
+static size_t putVarint(uint8_t *p, uint64_t v)
+{
+  size_t n = 0;
+  while (v >= 0x80)
+  {
+    p[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t)v;
+  return n;
+}
+
+static size_t getVarint(const uint8_t *p, uint64_t &v)
+{
+  size_t n = 0;
+  int shift = 0;
+  v = 0;
+  uint8_t b;
+  do
+  {
+    b = p[n++];
+    v |= (uint64_t)(b & 0x7f) << shift;
+    shift += 7;
+  } while (b & 0x80);
+  return n;
+}
+
+static inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+static inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+void EventStore::Codec::reset(uint32_t baseTime)
+{
+  prevTime = baseTime;
+  prevDelta = 0;
+  memset(lastValue, 0, sizeof(lastValue));
+}
+
+EventStore::EventStore() : data(nullptr), blocks(nullptr), blockCount(0)
+{
+  clear();
+}
+
+EventStore::~EventStore()
+{
+  free(data);
+  free(blocks);
+}
+
+bool EventStore::begin()
+{
+  if (data)
+    return true;
+
+  size_t n = LOG_BLOCKS_INTERNAL;
+  if (hal::hasPsram())
+  {
+    // the index of 1024 blocks is 12 KB, it goes to PSRAM with the data so the
+    // internal RAM footprint stays below the old fixed buffer; appends and
+    // lookups (binary search) touch only a few entries, so PSRAM latency hardly shows
+    data = (uint8_t *)hal::allocLarge(LOG_BLOCKS_PSRAM * LOG_BLOCK_SIZE);
+    blocks = (BlockInfo *)hal::allocLarge(LOG_BLOCKS_PSRAM * sizeof(BlockInfo));
+    if (data && blocks)
+    {
+      n = LOG_BLOCKS_PSRAM;
+    }
+    else
+    {
+      free(data);
+      free(blocks);
+      data = nullptr;
+      blocks = nullptr;
+    }
+  }
+  if (!data)
+  {
+    data = (uint8_t *)malloc(n * LOG_BLOCK_SIZE);
+    blocks = (BlockInfo *)malloc(n * sizeof(BlockInfo));
+  }
+  if (!data || !blocks)
+  {
+    free(data);
+    free(blocks);
+    data = nullptr;
+    blocks = nullptr;
+    return false;
+  }
+  blockCount = n;
+  clear();
+  return true;
+}
+
+void EventStore::clear()
+{
+  oldest = 0;
+  used = 0;
+  nextSeq = 0;
+  writer.reset(0);
+}
+
+uint32_t EventStore::firstSeq() const
+{
+  return used ? blocks[oldest].firstSeq : nextSeq;
+}
+
+void EventStore::startBlock(uint32_t time)
+{
+  if (used == blockCount)
+  {
+    // drop oldest block with all its events
+    oldest = (oldest + 1) % blockCount;
+    used--;
+  }
+  BlockInfo &b = blocks[blockAt(used)];
+  b.firstSeq = nextSeq;
+  b.firstTime = time;
+  b.count = 0;
+  b.used = 0;
+  used++;
+  writer.reset(time);
+}
+
+void EventStore::append(const Event &event)
+{
+  if (!blockCount)
+    return;
+
+  uint32_t time = (uint32_t)event.timestamp;
+  uint8_t type = (uint8_t)event.eventType;
+  if (type >= LOG_TYPE_COUNT)
+    type = EVENT_UNKNOWN;
+
+  if (!used || blocks[blockAt(used - 1)].used + MAX_EVENT_BYTES > LOG_BLOCK_SIZE)
+    startBlock(time);
+
+  BlockInfo &b = blocks[blockAt(used - 1)];
+  uint8_t *p = blockData(blockAt(used - 1)) + b.used;
+  int32_t delta = (int32_t)(time - writer.prevTime);
+  size_t n = 0;
+  p[n++] = type;
+  n += putVarint(p + n, zigzag((int64_t)delta - writer.prevDelta));
+  n += putVarint(p + n, zigzag((int32_t)event.value - (int32_t)writer.lastValue[type]));
+
+  writer.prevTime = time;
+  writer.prevDelta = delta;
+  writer.lastValue[type] = event.value;
+  b.used += n;
+  b.count++;
+  nextSeq++;
+}
+
+size_t EventStore::findBlock(uint32_t seq) const
+{
+  // blocks are ordered by firstSeq, find last one starting at or before seq
+  size_t lo = 0, hi = used;
+  while (hi - lo > 1)
+  {
+    size_t mid = (lo + hi) / 2;
+    if ((int32_t)(seq - blocks[blockAt(mid)].firstSeq) >= 0)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+size_t EventStore::read(uint32_t seq, Event *out, size_t maxCount) const
+{
+  if (!used || (int32_t)(seq - firstSeq()) < 0 || (int32_t)(nextSeq - seq) <= 0)
+    return 0;
+
+  size_t copied = 0;
+  for (size_t i = findBlock(seq); i < used && copied < maxCount; i++)
+  {
+    const BlockInfo &b = blocks[blockAt(i)];
+    const uint8_t *p = blockData(blockAt(i));
+    Codec reader;
+    reader.reset(b.firstTime);
+    uint32_t s = b.firstSeq;
+    for (uint16_t k = 0; k < b.count && copied < maxCount; k++, s++)
+    {
+      uint64_t v;
+      uint8_t type = *p++;
+      p += getVarint(p, v);
+      int32_t delta = reader.prevDelta + (int32_t)unzigzag(v);
+      reader.prevTime += delta;
+      reader.prevDelta = delta;
+      p += getVarint(p, v);
+      reader.lastValue[type] = (uint16_t)(reader.lastValue[type] + unzigzag(v));
+
+      // events before seq are decoded only to rebuild predictor state
+      if ((int32_t)(s - seq) >= 0)
+      {
+        Event &e = out[copied++];
+        e.timestamp = reader.prevTime;
+        e.eventType = (event_type_t)type;
+        e.value = reader.lastValue[type];
+      }
+    }
+  }
+  return copied;
+}
+
+uint32_t EventStore::seekTime(uint32_t time) const
+{
+  // first block starting at or after time
+  size_t lo = 0, hi = used;
+  while (lo < hi)
+  {
+    size_t mid = (lo + hi) / 2;
+    if (blocks[blockAt(mid)].firstTime < time)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return firstSeq();
+
+  // answer is inside the previous block or is the start of block lo
+  const BlockInfo &b = blocks[blockAt(lo - 1)];
+  const uint8_t *p = blockData(blockAt(lo - 1));
+  Codec reader;
+  reader.reset(b.firstTime);
+  for (uint16_t k = 0; k < b.count; k++)
+  {
+    uint64_t v;
+    p++; // type
+    p += getVarint(p, v);
+    reader.prevDelta += (int32_t)unzigzag(v);
+    reader.prevTime += reader.prevDelta;
+    p += getVarint(p, v);
+    if (reader.prevTime >= time)
+      return b.firstSeq + k;
+  }
+  return lo < used ? blocks[blockAt(lo)].firstSeq : nextSeq;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "Event.h"
+
+// Compressed time-ordered event storage used by LogManager.
+//
+// Events are appended into fixed-size blocks organized as a ring; when all
+// blocks are used the oldest block is dropped as a whole. Inside a block every
+// event is encoded as:
+//   1 byte   event type
+//   varint   zigzag delta-of-delta of timestamp (seconds)
+//   varint   zigzag delta of value against previous value of the same type
+// Periodic readings compress to 3-4 bytes per event instead of 16 for Event.
+//
+// Not thread safe, LogManager serializes access.
+
+#define LOG_BLOCK_SIZE 256       // bytes of encoded events per block
+#define LOG_BLOCKS_INTERNAL 32   // 8 KB in internal RAM when there is no PSRAM
+#define LOG_BLOCKS_PSRAM 1024    // 256 KB when PSRAM is available
+#define LOG_TYPE_COUNT 16        // per-type value predictors, event types must be below this
+
+class EventStore {
+public:
+    EventStore();
+    ~EventStore();
+
+    // Allocates block storage, in PSRAM when available. Safe to call once.
+    bool begin();
+    void clear();
+
+    void append(const Event &event);
+
+    // Sequence numbers of stored events are [firstSeq(), endSeq())
+    uint32_t firstSeq() const;
+    uint32_t endSeq() const { return nextSeq; }
+    size_t count() const { return endSeq() - firstSeq(); }
+    size_t capacityBytes() const { return blockCount * LOG_BLOCK_SIZE; }
+
+    // Decodes up to maxCount events starting at seq. Returns number decoded.
+    size_t read(uint32_t seq, Event *out, size_t maxCount) const;
+    // Sequence number of first event with timestamp >= time, endSeq() if none.
+    // Binary search over block index, then decodes a single block.
+    // Assumes timestamps do not go backwards.
+    uint32_t seekTime(uint32_t time) const;
+
+private:
+    struct BlockInfo {
+        uint32_t firstSeq;   // sequence number of first event in block
+        uint32_t firstTime;  // timestamp base for delta-of-delta decoding
+        uint16_t count;      // events in block
+        uint16_t used;       // encoded bytes in block
+    };
+
+    // Decoder/encoder state, reset at every block start
+    struct Codec {
+        uint32_t prevTime;
+        int32_t prevDelta;
+        uint16_t lastValue[LOG_TYPE_COUNT];
+        void reset(uint32_t baseTime);
+    };
+
+    // Worst case encoded event: type + 10 byte varint + 3 byte varint
+    static constexpr size_t MAX_EVENT_BYTES = 14;
+
+    uint8_t *blockData(size_t block) const { return data + block * LOG_BLOCK_SIZE; }
+    size_t blockAt(size_t i) const { return (oldest + i) % blockCount; } // i-th oldest block
+    size_t findBlock(uint32_t seq) const;  // ring position i of block holding seq
+    void startBlock(uint32_t time);
+
+    uint8_t *data;
+    BlockInfo *blocks;
+    size_t blockCount;  // allocated blocks
+    size_t oldest;      // ring index of oldest block
+    size_t used;        // blocks in use, newest is blockAt(used - 1)
+    uint32_t nextSeq;   // sequence number of next appended event
+    Codec writer;       // encoder state of newest block
+};
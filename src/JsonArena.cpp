@@ -0,0 +1,229 @@
+#include "JsonArena.h"
+#include <stdlib.h>
+#include <string.h>
+
+extern JsonPool jsonPool;
+
+static_assert(JSON_POOL_BLOCKS_PSRAM <= 32 && JSON_POOL_BLOCKS_INTERNAL <= 32, "free mask holds 32 blocks");
+
+// Every allocation is preceded by its requested size, padded to keep
+// ArduinoJson's slots 8 byte aligned
+#define JSON_ALLOC_HEADER 8
+
+static inline size_t alignUp(size_t size)
+{
+  return (size + 7) & ~(size_t)7;
+}
+
+static inline uint32_t &allocSize(void *ptr)
+{
+  return *(uint32_t *)((uint8_t *)ptr - JSON_ALLOC_HEADER);
+}
+
+static void *allocFallback(size_t size)
+{
+  uint8_t *p = (uint8_t *)hal::allocLarge(size + JSON_ALLOC_HEADER);
+  if (!p)
+    return nullptr;
+  jsonPool.countOverflow();
+  *(uint32_t *)p = size;
+  return p + JSON_ALLOC_HEADER;
+}
+
+static void freeFallback(void *ptr)
+{
+  free((uint8_t *)ptr - JSON_ALLOC_HEADER);
+}
+
+// ===============================================================
+// JsonPool
+// ===============================================================
+
+JsonPool::JsonPool() : data(nullptr), blockCount(0), freeMask(0)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool JsonPool::begin()
+{
+  if (data)
+    return true;
+
+  size_t n = JSON_POOL_BLOCKS_INTERNAL;
+  if (hal::hasPsram())
+  {
+    data = (uint8_t *)hal::allocLarge(JSON_POOL_BLOCKS_PSRAM * JSON_POOL_BLOCK_SIZE);
+    if (data)
+      n = JSON_POOL_BLOCKS_PSRAM;
+  }
+  if (!data)
+    data = (uint8_t *)malloc(n * JSON_POOL_BLOCK_SIZE);
+  if (!data)
+    return false;
+
+  blockCount = n;
+  freeMask = n == 32 ? 0xFFFFFFFFu : (1u << n) - 1;
+  stats.blocks = n;
+  hal::logf("[JsonPool] %u blocks of %u bytes%s\n", (unsigned)n, (unsigned)JSON_POOL_BLOCK_SIZE,
+            n == JSON_POOL_BLOCKS_PSRAM ? " in PSRAM" : "");
+  return true;
+}
+
+void *JsonPool::acquire()
+{
+  void *block = nullptr;
+  if (mutex.lock())
+  {
+    if (freeMask)
+    {
+      int i = __builtin_ctz(freeMask);
+      freeMask &= ~(1u << i);
+      block = data + (size_t)i * JSON_POOL_BLOCK_SIZE;
+      if (++stats.inUse > stats.peakInUse)
+        stats.peakInUse = stats.inUse;
+    }
+    else
+    {
+      stats.exhausted++;
+    }
+    mutex.unlock();
+  }
+  return block;
+}
+
+void JsonPool::release(void *block)
+{
+  if (!block || !owns(block))
+    return;
+  size_t i = ((uint8_t *)block - data) / JSON_POOL_BLOCK_SIZE;
+  if (mutex.lock())
+  {
+    freeMask |= 1u << i;
+    stats.inUse--;
+    mutex.unlock();
+  }
+}
+
+bool JsonPool::owns(const void *ptr) const
+{
+  const uint8_t *p = (const uint8_t *)ptr;
+  return data && p >= data && p < data + blockCount * JSON_POOL_BLOCK_SIZE;
+}
+
+void JsonPool::countOverflow()
+{
+  if (mutex.lock())
+  {
+    stats.overflows++;
+    mutex.unlock();
+  }
+}
+
+JsonPoolStats JsonPool::getStats() const
+{
+  JsonPoolStats s;
+  memset(&s, 0, sizeof(s));
+  if (mutex.lock())
+  {
+    s = stats;
+    mutex.unlock();
+  }
+  return s;
+}
+
+// ===============================================================
+// JsonArena
+// ===============================================================
+
+JsonArena::JsonArena() : block((uint8_t *)jsonPool.acquire()), top(0), last(0)
+{
+}
+
+JsonArena::~JsonArena()
+{
+  jsonPool.release(block);
+}
+
+bool JsonArena::owns(const void *ptr) const
+{
+  const uint8_t *p = (const uint8_t *)ptr;
+  return block && p >= block && p < block + JSON_POOL_BLOCK_SIZE;
+}
+
+void *JsonArena::allocate(size_t size)
+{
+  size_t need = alignUp(size);
+  if (block && top + JSON_ALLOC_HEADER + need <= JSON_POOL_BLOCK_SIZE)
+  {
+    last = top + JSON_ALLOC_HEADER;
+    top = last + need;
+    allocSize(block + last) = size;
+    return block + last;
+  }
+  return allocFallback(size);
+}
+
+void JsonArena::deallocate(void *ptr)
+{
+  if (!ptr)
+    return;
+  if (!owns(ptr))
+  {
+    freeFallback(ptr);
+    return;
+  }
+  // only the most recent allocation can be given back, the rest goes with the block
+  if ((uint8_t *)ptr == block + last)
+  {
+    top = last - JSON_ALLOC_HEADER;
+    last = 0;
+  }
+}
+
+void *JsonArena::reallocate(void *ptr, size_t newSize)
+{
+  if (!ptr)
+    return allocate(newSize);
+
+  // ArduinoJson grows and shrinks the string or pool it just allocated
+  if ((uint8_t *)ptr == block + last && last + alignUp(newSize) <= JSON_POOL_BLOCK_SIZE)
+  {
+    allocSize(ptr) = newSize;
+    top = last + alignUp(newSize);
+    return ptr;
+  }
+
+  size_t oldSize = allocSize(ptr);
+  void *p = allocate(newSize);
+  if (!p)
+    return nullptr;
+  memcpy(p, ptr, oldSize < newSize ? oldSize : newSize);
+  deallocate(ptr);
+  return p;
+}
+
+// ===============================================================
+// JsonBuffer
+// ===============================================================
+
+JsonBuffer::JsonBuffer(size_t capacity) : buffer(nullptr), size(capacity), pooled(false)
+{
+  if (capacity <= JSON_POOL_BLOCK_SIZE)
+    buffer = (uint8_t *)jsonPool.acquire();
+  if (buffer)
+  {
+    pooled = true;
+    return;
+  }
+  buffer = (uint8_t *)hal::allocLarge(capacity ? capacity : 1);
+  if (buffer)
+    jsonPool.countOverflow();
+}
+
+JsonBuffer::~JsonBuffer()
+{
+  if (pooled)
+    jsonPool.release(buffer);
+  else
+    free(buffer);
+}
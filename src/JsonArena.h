@@ -0,0 +1,96 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <ArduinoJson.h>
+#include "hal/Hal.h"
+
+// Pooled memory for HTTP handler JSON documents and response bodies.
+//
+// Every handler used to build its JsonDocument and serialized body on the
+// general heap, a few hundred short-lived blocks per request that fragment
+// internal RAM over weeks of uptime. JsonPool reserves fixed size blocks once
+// at boot (in PSRAM when available) and lends them out:
+// - JsonArena is an ArduinoJson allocator that bump-allocates from one block
+//   for the lifetime of a handler's document. Frees are no-ops except for the
+//   most recent allocation, so ArduinoJson growing or shrinking the pool or
+//   string it is building happens in place.
+// - JsonBuffer holds a serialized body until the response is sent.
+// When a block is full or all blocks are lent out, allocations fall back to
+// hal::allocLarge (PSRAM when available) and are counted as overflows.
+// Handlers all run on the async_tcp task, the mutex only guards against
+// responses released from elsewhere.
+
+#define JSON_POOL_BLOCK_SIZE (8 * 1024)
+#define JSON_POOL_BLOCKS_PSRAM 16   // 128 KB when PSRAM is available
+#define JSON_POOL_BLOCKS_INTERNAL 4 // 32 KB in internal RAM otherwise
+
+struct JsonPoolStats {
+    size_t blocks;      // reserved at boot
+    size_t inUse;       // currently lent out
+    size_t peakInUse;
+    uint32_t exhausted; // acquire() found no free block
+    uint32_t overflows; // allocations served by the fallback heap
+};
+
+class JsonPool {
+public:
+    JsonPool();
+
+    bool begin();
+    // Returns a free JSON_POOL_BLOCK_SIZE block, nullptr if all are lent out
+    void *acquire();
+    void release(void *block);
+    bool owns(const void *ptr) const;
+
+    void countOverflow();
+    JsonPoolStats getStats() const;
+    hal::MutexStats getMutexStats() const { return mutex.getStats(); }
+
+private:
+    uint8_t *data;
+    size_t blockCount;
+    uint32_t freeMask; // bit per block, set when free
+    JsonPoolStats stats;
+    mutable hal::Mutex mutex;
+};
+
+// ArduinoJson allocator over one pooled block, use as
+//   JsonArena arena;
+//   JsonDocument doc(&arena);
+// declared in this order, so the document is destroyed first.
+class JsonArena : public ArduinoJson::Allocator {
+public:
+    JsonArena();
+    ~JsonArena();
+    JsonArena(const JsonArena &) = delete;
+    JsonArena &operator=(const JsonArena &) = delete;
+
+    void *allocate(size_t size) override;
+    void deallocate(void *ptr) override;
+    void *reallocate(void *ptr, size_t newSize) override;
+
+private:
+    bool owns(const void *ptr) const;
+
+    uint8_t *block; // nullptr when the pool was empty, everything goes to the fallback heap
+    size_t top;     // first free byte
+    size_t last;    // offset of the most recent allocation, 0 if none
+};
+
+// Serialized response body in a pooled block (or the fallback heap if larger)
+class JsonBuffer {
+public:
+    explicit JsonBuffer(size_t capacity);
+    ~JsonBuffer();
+    JsonBuffer(const JsonBuffer &) = delete;
+    JsonBuffer &operator=(const JsonBuffer &) = delete;
+
+    uint8_t *data() const { return buffer; }
+    size_t capacity() const { return size; }
+    bool ok() const { return buffer != nullptr; }
+
+private:
+    uint8_t *buffer;
+    size_t size;
+    bool pooled;
+};
@@ -2,105 +2,210 @@
 
 LogManager::LogManager()
 {
-  mutex = xSemaphoreCreateMutex();
   clear();
 }
 
-void LogManager::addSoilEvent(uint8_t sensorId, int value)
+void LogManager::begin()
 {
-  if (xSemaphoreTake(mutex, portMAX_DELAY))
+  if (mutex.lock())
   {
-    Event event;
-    event.timestamp = time(nullptr);
+    if (!store.begin())
+      hal::logf("[Log] Failed to allocate event storage, logging disabled\n");
+    else
+      hal::logf("[Log] Event storage: %u bytes\n", (unsigned)store.capacityBytes());
+    if (!rollup.begin())
+      hal::logf("[Log] Failed to allocate soil rollups\n");
 
-    switch (sensorId)
+    if (journal.begin())
     {
-    case 0:
-      event.eventType = EVENT_SOIL_READINGS_0;
-      break;
-    case 1:
-      event.eventType = EVENT_SOIL_READINGS_1;
-      break;
-    case 2:
-      event.eventType = EVENT_SOIL_READINGS_2;
-      break;
-    case 3:
-      event.eventType = EVENT_SOIL_READINGS_3;
-      break;
-    default:
-      event.eventType = EVENT_UNKNOWN;
-      break;
+      uint32_t start = hal::uptimeMs();
+      size_t n = journal.replay([this](const Event &event)
+                                { ingest(event); });
+      hal::logf("[Log] Restored %u events from journal in %u ms\n", (unsigned)n, (unsigned)(hal::uptimeMs() - start));
     }
-    event.value = value;
-    pushEvent(event);
-    xSemaphoreGive(mutex);
+    mutex.unlock();
   }
 }
 
-void LogManager::addWaterEvent(uint8_t valveId, int durationSec)
+void LogManager::sync(bool force)
+{
+  // flushes outside of the store mutex, readers and producers are not held up by flash
+  journal.sync(force);
+}
+
+void LogManager::addSoilEvent(uint8_t sensorId, int value)
 {
-  if (xSemaphoreTake(mutex, portMAX_DELAY))
+  Event event;
+  event.timestamp = hal::now();
+
+  switch (sensorId)
   {
-    Event event;
-    event.timestamp = time(nullptr);
+  case 0:
+    event.eventType = EVENT_SOIL_READINGS_0;
+    break;
+  case 1:
+    event.eventType = EVENT_SOIL_READINGS_1;
+    break;
+  case 2:
+    event.eventType = EVENT_SOIL_READINGS_2;
+    break;
+  case 3:
+    event.eventType = EVENT_SOIL_READINGS_3;
+    break;
+  default:
+    event.eventType = EVENT_UNKNOWN;
+    break;
+  }
+  event.value = value;
+  pushEvent(event);
+}
 
-    switch (valveId)
-    {
-    case 0:
-      event.eventType = EVENT_WATERING_0;
-      break;
-    case 1:
-      event.eventType = EVENT_WATERING_1;
-      break;
-    case 2:
-      event.eventType = EVENT_WATERING_2;
-      break;
-    case 3:
-      event.eventType = EVENT_WATERING_3;
-      break;
-    default:
-      event.eventType = EVENT_UNKNOWN;
-      break;
-    }
-    event.value = durationSec;
-    pushEvent(event);
-    xSemaphoreGive(mutex);
+void LogManager::addWaterEvent(uint8_t valveId, int durationSec)
+{
+  Event event;
+  event.timestamp = hal::now();
+
+  switch (valveId)
+  {
+  case 0:
+    event.eventType = EVENT_WATERING_0;
+    break;
+  case 1:
+    event.eventType = EVENT_WATERING_1;
+    break;
+  case 2:
+    event.eventType = EVENT_WATERING_2;
+    break;
+  case 3:
+    event.eventType = EVENT_WATERING_3;
+    break;
+  default:
+    event.eventType = EVENT_UNKNOWN;
+    break;
   }
+  event.value = durationSec;
+  pushEvent(event);
 }
 
 void LogManager::pushEvent(const Event &event)
 {
-  log[head] = event;
-  head = (head + 1) % MAX_LOGS;
-
-  if (count < MAX_LOGS)
+  staging.push(event);
+  // drain only if nobody holds the store, otherwise the next reader or producer will
+  if (mutex.lock(0))
   {
-    count++;
+    drainStaged();
+    mutex.unlock();
   }
-  // If buffer full, head will overwrite oldest
+  if (listener)
+    listener(event);
+}
+
+void LogManager::drainStaged() const
+{
+  staging.drain([this](const Event &event)
+                {
+                  ingest(event);
+                  journal.record(event); });
+}
+
+void LogManager::ingest(const Event &event) const
+{
+  store.append(event);
+  if (event.eventType >= EVENT_SOIL_READINGS_0 && event.eventType <= EVENT_SOIL_READINGS_3)
+    rollup.add(event.eventType - EVENT_SOIL_READINGS_0, (uint32_t)event.timestamp, event.value);
 }
 
 int LogManager::getEventCount() const
 {
-  return count;
+  int result = 0;
+  if (mutex.lock())
+  {
+    drainStaged();
+    result = store.count();
+    mutex.unlock();
+  }
+  return result;
+}
+
+LogStats LogManager::getStats() const
+{
+  LogStats stats = {staging.pushedCount(), staging.droppedCount(), 0, 0};
+  if (mutex.lock())
+  {
+    drainStaged();
+    stats.journalDropped = journal.droppedCount();
+    stats.events = store.count();
+    mutex.unlock();
+  }
+  return stats;
 }
 
 Event LogManager::getEvent(int index) const
 {
   Event result = {0, EVENT_UNKNOWN, 0};
-  if (xSemaphoreTake(mutex, portMAX_DELAY))
+  if (mutex.lock())
   {
-    if (index >= 0 && index < count)
-    {
-      int pos = (head - count + index + MAX_LOGS) % MAX_LOGS;
-      result = log[pos];
-    }
-    xSemaphoreGive(mutex);
+    drainStaged();
+    if (index >= 0)
+      store.read(store.firstSeq() + index, &result, 1);
+    mutex.unlock();
   }
   return result;
 }
 
-String LogManager::getEventTypeName(event_type_t type)
+void LogManager::getSeqRange(uint32_t &firstSeq, uint32_t &endSeq) const
+{
+  firstSeq = endSeq = 0;
+  if (mutex.lock())
+  {
+    drainStaged();
+    firstSeq = store.firstSeq();
+    endSeq = store.endSeq();
+    mutex.unlock();
+  }
+}
+
+size_t LogManager::readEvents(uint32_t &cursor, Event *out, size_t maxCount) const
+{
+  size_t copied = 0;
+  if (mutex.lock())
+  {
+    drainStaged();
+    // signed distance keeps this correct across sequence wrap-around
+    if ((int32_t)(cursor - store.firstSeq()) < 0)
+      cursor = store.firstSeq();
+    copied = store.read(cursor, out, maxCount);
+    cursor += copied;
+    mutex.unlock();
+  }
+  return copied;
+}
+
+uint32_t LogManager::seekTime(time_t time) const
+{
+  uint32_t result = 0;
+  if (mutex.lock())
+  {
+    drainStaged();
+    result = time <= 0 ? store.firstSeq() : store.seekTime((uint32_t)time);
+    mutex.unlock();
+  }
+  return result;
+}
+
+size_t LogManager::getRollup(uint8_t sensorId, rollup_tier_t tier, RollupBucket *out, size_t maxCount) const
+{
+  size_t result = 0;
+  if (mutex.lock())
+  {
+    drainStaged();
+    result = rollup.read(sensorId, tier, out, maxCount);
+    mutex.unlock();
+  }
+  return result;
+}
+
+const char *LogManager::getEventTypeName(event_type_t type) const
 {
   switch (type)
   {
@@ -129,14 +234,11 @@ String LogManager::getEventTypeName(event_type_t type)
 
 void LogManager::clear()
 {
-  if (xSemaphoreTake(mutex, portMAX_DELAY))
+  if (mutex.lock())
   {
-    head = 0;
-    count = 0;
-    for (int i = 0; i < MAX_LOGS; i++)
-    {
-      log[i] = {0, EVENT_UNKNOWN, 0};
-    }
-    xSemaphoreGive(mutex);
+    staging.drain([](const Event &) {});
+    store.clear();
+    rollup.clear();
+    mutex.unlock();
   }
 }
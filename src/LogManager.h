@@ -1,45 +1,74 @@
 #pragma once
-#include <Arduino.h>
-
-#define  MAX_LOGS 512
-
-// Log uses ring buffer, overwriting oldest events when full
-
-typedef enum
-{
-  EVENT_UNKNOWN,         //!< Event reason can not be determined
-  EVENT_SOIL_READINGS_0, //!< Soil humidity reading on sensor 0
-  EVENT_SOIL_READINGS_1, //!< Soil humidity reading on sensor 1
-  EVENT_SOIL_READINGS_2, //!< Soil humidity reading on sensor 2
-  EVENT_SOIL_READINGS_3, //!< Soil humidity reading on sensor 3
-  EVENT_WATERING_0,      //!< Watering event on valve 0
-  EVENT_WATERING_1,      //!< Watering event on valve 1
-  EVENT_WATERING_2,      //!< Watering event on valve 2
-  EVENT_WATERING_3       //!< Watering event on valve 3
-} event_type_t;
-
-struct Event
-{
-  time_t timestamp;
-  event_type_t eventType; //!< Event type
-  uint16_t value;          //!< Depending on event type: soil humidity (1-4096) or watering duration (s)
+#include <stddef.h>
+#include <stdint.h>
+#include "hal/Hal.h"
+#include "Event.h"
+#include "EventStore.h"
+#include "EventRing.h"
+#include "EventJournal.h"
+#include "SoilRollup.h"
+
+// Log uses compressed ring of blocks (EventStore), dropping oldest events when full.
+// Producers never block: events go to a lock-free staging ring and are moved
+// into the store by whoever holds the mutex next (a producer that gets it
+// without waiting, or any reader).
+// Events are also journaled to flash and restored from there on boot.
+
+// Counters for /metrics
+struct LogStats {
+    uint32_t pushed;         // events produced since boot
+    uint32_t stagingDropped; // lost because the staging ring overflowed
+    uint32_t journalDropped; // not written to flash (journal full or write failed)
+    size_t events;           // events currently in the store
 };
 
 class LogManager {
 public:
     LogManager();
 
+    // Allocates event storage (PSRAM when available) and replays the flash journal,
+    // call once from setup()
+    void begin();
+    // Writes journaled events to flash when due (or always with force), may block on flash
+    void sync(bool force = false);
     void addSoilEvent(uint8_t sensorId, int value);
     void addWaterEvent(uint8_t valveId, int durationSec);
     void clear();
-    String getEventTypeName(event_type_t type);
+    const char *getEventTypeName(event_type_t type) const;
     int getEventCount() const;
     Event getEvent(int index) const;
 
+    // Cursor API: every pushed event gets a sequence number, cursors are sequence numbers.
+    // Valid events are [firstSeq, endSeq); older ones were overwritten.
+    void getSeqRange(uint32_t &firstSeq, uint32_t &endSeq) const;
+    // Copies up to maxCount events starting at cursor under a single lock.
+    // Cursor is clamped forward if its events were overwritten and advanced past the copied ones.
+    size_t readEvents(uint32_t &cursor, Event *out, size_t maxCount) const;
+    // Cursor of first event with timestamp >= time (binary search, no scan)
+    uint32_t seekTime(time_t time) const;
+
+    // Called from the producing task for every new event, outside of any lock.
+    // Set once before tasks start.
+    typedef void (*EventListener)(const Event &event);
+    void setListener(EventListener listener) { this->listener = listener; }
+
+    // Hourly/daily soil reading aggregates of one sensor, oldest first
+    size_t getRollup(uint8_t sensorId, rollup_tier_t tier, RollupBucket *out, size_t maxCount) const;
+
+    LogStats getStats() const;
+    hal::MutexStats getMutexStats() const { return mutex.getStats(); }
+    hal::MutexStats getJournalMutexStats() const { return journal.getMutexStats(); }
+    hal::MutexStats getJournalIoMutexStats() const { return journal.getIoMutexStats(); }
+
 private:
     void pushEvent(const Event &event);
-    SemaphoreHandle_t mutex;
-    Event log[MAX_LOGS];
-    size_t head;     // next write position
-    size_t count;    // number of valid events
+    void drainStaged() const; // moves staged events into store, mutex must be held
+    void ingest(const Event &event) const; // adds event to store and rollups, mutex must be held
+    mutable hal::Mutex mutex;  // guards store, taken by readers and by whoever drains
+    // readers drain staged events before reading, hence mutable
+    mutable EventRing staging; // lock-free, producers only push here
+    mutable EventStore store;
+    mutable EventJournal journal; // every event entering the store is journaled
+    mutable SoilRollup rollup;    // fed from the same path, so journal replay rebuilds it too
+    EventListener listener = nullptr;
 };
\ No newline at end of file
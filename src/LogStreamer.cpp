@@ -0,0 +1,248 @@
+#include "LogStreamer.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+// --- minimal MessagePack writer, callers guarantee buffer space ---
+static size_t packUint(uint8_t *p, uint32_t v)
+{
+  if (v < 0x80)
+  {
+    p[0] = v;
+    return 1;
+  }
+  if (v <= 0xff)
+  {
+    p[0] = 0xcc;
+    p[1] = v;
+    return 2;
+  }
+  if (v <= 0xffff)
+  {
+    p[0] = 0xcd;
+    p[1] = v >> 8;
+    p[2] = v;
+    return 3;
+  }
+  p[0] = 0xce;
+  p[1] = v >> 24;
+  p[2] = v >> 16;
+  p[3] = v >> 8;
+  p[4] = v;
+  return 5;
+}
+
+static size_t packStr(uint8_t *p, const char *s)
+{
+  size_t len = strlen(s); // short keys and type names only, fixstr
+  p[0] = 0xa0 | len;
+  memcpy(p + 1, s, len);
+  return len + 1;
+}
+
+static size_t packArray(uint8_t *p, size_t count)
+{
+  if (count < 16)
+  {
+    p[0] = 0x90 | count;
+    return 1;
+  }
+  p[0] = 0xdc;
+  p[1] = count >> 8;
+  p[2] = count;
+  return 3;
+}
+
+LogStreamer::LogStreamer(LogManager &logs, const LogQuery &query, response_format_t format)
+    : logs(logs), query(query), format(format), skipped(0), emitted(0), batchLen(0), batchPos(0), opened(false), closed(false), pendingLen(0), pendingPos(0)
+{
+  logs.getSeqRange(cursor, endSeq);
+  if (query.from > 0)
+    cursor = logs.seekTime(query.from);
+  if (query.to > 0)
+    endSeq = logs.seekTime(query.to + 1);
+}
+
+const char *LogStreamer::contentType(response_format_t format)
+{
+  switch (format)
+  {
+  case FORMAT_CSV:
+    return "text/csv";
+  case FORMAT_MSGPACK:
+    return "application/msgpack";
+  default:
+    return "application/json";
+  }
+}
+
+bool LogStreamer::nextMatch(Event &event)
+{
+  while (query.limit == 0 || emitted < query.limit)
+  {
+    if (batchPos >= batchLen)
+    {
+      if ((int32_t)(endSeq - cursor) <= 0)
+        return false;
+      // one lock acquisition per batch
+      batchLen = logs.readEvents(cursor, batch, std::min(BATCH, (size_t)(endSeq - cursor)));
+      batchPos = 0;
+      if (batchLen == 0)
+        return false;
+    }
+    const Event &e = batch[batchPos++];
+    if (!(query.typeMask & (1u << e.eventType)))
+      continue;
+    if (skipped < query.offset)
+    {
+      skipped++;
+      continue;
+    }
+    event = e;
+    emitted++;
+    return true;
+  }
+  return false;
+}
+
+// Timestamp for JSON and CSV rows: local time (quoted for JSON), or bare epoch seconds
+const char *LogStreamer::timestamp(time_t t, char *buf, bool quoted)
+{
+  if (query.epochTimestamps)
+  {
+    snprintf(buf, 22, "%lu", (unsigned long)t);
+    return buf;
+  }
+  if (!quoted)
+  {
+    timestamps.format(buf, t);
+    return buf;
+  }
+  buf[0] = '"';
+  timestamps.format(buf + 1, t);
+  buf[TIMESTAMP_LEN + 1] = '"';
+  buf[TIMESTAMP_LEN + 2] = '\0';
+  return buf;
+}
+
+bool LogStreamer::renderJson()
+{
+  if (!opened)
+  {
+    opened = true;
+    pending[0] = '[';
+    pendingLen = 1;
+    return true;
+  }
+  Event event;
+  bool first = emitted == 0;
+  if (nextMatch(event))
+  {
+    char ts[22];
+    int n = snprintf(pending, sizeof(pending), "%s{\"timestamp\":%s,\"eventType\":\"%s\",\"value\":%u}",
+                     first ? "" : ",", timestamp(event.timestamp, ts, true), logs.getEventTypeName(event.eventType), event.value);
+    pendingLen = (n > 0 && (size_t)n < sizeof(pending)) ? n : 0;
+    return true;
+  }
+  if (!closed)
+  {
+    closed = true;
+    pending[0] = ']';
+    pendingLen = 1;
+    return true;
+  }
+  return false;
+}
+
+bool LogStreamer::renderCsv()
+{
+  if (!opened)
+  {
+    opened = true;
+    pendingLen = snprintf(pending, sizeof(pending), "timestamp,eventType,value\n");
+    return true;
+  }
+  Event event;
+  if (nextMatch(event))
+  {
+    char ts[22];
+    int n = snprintf(pending, sizeof(pending), "%s,%s,%u\n", timestamp(event.timestamp, ts, false),
+                     logs.getEventTypeName(event.eventType), event.value);
+    pendingLen = (n > 0 && (size_t)n < sizeof(pending)) ? n : 0;
+    return true;
+  }
+  return false;
+}
+
+bool LogStreamer::renderMsgPack()
+{
+  uint8_t *p = (uint8_t *)pending;
+  size_t n = 0;
+  if (!opened)
+  {
+    // header object maps event type numbers to names
+    opened = true;
+    p[n++] = 0x81; // fixmap, 1 entry
+    n += packStr(p + n, "types");
+    n += packArray(p + n, EVENT_TYPE_COUNT);
+    for (int t = 0; t < EVENT_TYPE_COUNT; t++)
+      n += packStr(p + n, logs.getEventTypeName((event_type_t)t));
+    pendingLen = n;
+    return true;
+  }
+
+  Event events[BATCH];
+  size_t count = 0;
+  while (count < BATCH && nextMatch(events[count]))
+    count++;
+  if (count == 0)
+    return false;
+
+  // worst case: 1 + 3 * (2 + 3) + BATCH * (5 + 1 + 3) = 160 bytes
+  p[n++] = 0x83; // fixmap, 3 entries
+  n += packStr(p + n, "t");
+  n += packArray(p + n, count);
+  for (size_t i = 0; i < count; i++)
+    n += packUint(p + n, (uint32_t)events[i].timestamp);
+  n += packStr(p + n, "e");
+  n += packArray(p + n, count);
+  for (size_t i = 0; i < count; i++)
+    n += packUint(p + n, events[i].eventType);
+  n += packStr(p + n, "v");
+  n += packArray(p + n, count);
+  for (size_t i = 0; i < count; i++)
+    n += packUint(p + n, events[i].value);
+  pendingLen = n;
+  return true;
+}
+
+bool LogStreamer::renderNext()
+{
+  pendingPos = 0;
+  pendingLen = 0;
+  switch (format)
+  {
+  case FORMAT_CSV:
+    return renderCsv();
+  case FORMAT_MSGPACK:
+    return renderMsgPack();
+  default:
+    return renderJson();
+  }
+}
+
+size_t LogStreamer::fill(uint8_t *buffer, size_t maxLen)
+{
+  size_t written = 0;
+  while (written < maxLen)
+  {
+    if (pendingPos >= pendingLen && !renderNext())
+      break;
+    size_t n = std::min(pendingLen - pendingPos, maxLen - written);
+    memcpy(buffer + written, pending + pendingPos, n);
+    pendingPos += n;
+    written += n;
+  }
+  return written;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "LogManager.h"
+#include "Timestamp.h"
+
+// Renders the event log piece by piece, so /logs can be served as a chunked
+// response without materializing the whole document.
+// Memory use is one batch of events, independent of log size.
+// The range of events is fixed when the streamer is created, events pushed
+// while streaming are not included; overwritten ones are skipped.
+// Time bounds are resolved to cursors by binary search, type/offset/limit
+// are applied while walking the range.
+//
+// Formats:
+//   JSON    - array of {"timestamp","eventType","value"} objects
+//   CSV     - header line, then timestamp,eventType,value rows
+//   JSON and CSV timestamps are local 'YYYY-MM-DD HH:MM:SS', or epoch
+//   seconds with LogQuery::epochTimestamps
+//   MsgPack - stream of MessagePack objects: first {"types":[names]}, then
+//             columnar blocks {"t":[epoch...],"e":[type...],"v":[value...]}
+//             of up to 16 events; types are indexes into the names list
+
+typedef enum
+{
+  FORMAT_JSON,
+  FORMAT_CSV,
+  FORMAT_MSGPACK
+} response_format_t;
+
+// Filters for /logs, defaults select everything
+struct LogQuery {
+    time_t from = 0;         // inclusive, 0 = oldest
+    time_t to = 0;           // inclusive, 0 = newest
+    uint32_t typeMask = ~0u; // bit per event_type_t
+    size_t offset = 0;       // matching events to skip
+    size_t limit = 0;        // max events to return, 0 = no limit
+    bool epochTimestamps = false; // JSON/CSV timestamps as epoch seconds instead of local time
+};
+
+class LogStreamer {
+public:
+    LogStreamer(LogManager &logs, const LogQuery &query = LogQuery(), response_format_t format = FORMAT_JSON);
+
+    // AsyncWebServer chunk filler: writes up to maxLen bytes, returns 0 when done
+    size_t fill(uint8_t *buffer, size_t maxLen);
+
+    static const char *contentType(response_format_t format);
+
+private:
+    static constexpr size_t BATCH = 16;
+
+    bool nextMatch(Event &event); // next event passing the query, false at end of range
+    bool renderNext();            // renders next piece into pending, false when finished
+    bool renderJson();
+    bool renderCsv();
+    bool renderMsgPack();
+    const char *timestamp(time_t t, char *buf, bool quoted); // buf needs 22 bytes
+
+    LogManager &logs;
+    LogQuery query;
+    response_format_t format;
+    size_t skipped;    // matching events skipped for offset
+    size_t emitted;    // matching events rendered
+    uint32_t cursor;   // sequence number of next event to fetch
+    uint32_t endSeq;   // end of range, snapshot at request start
+    Event batch[BATCH];
+    size_t batchLen;
+    size_t batchPos;
+    bool opened;       // header / '[' already emitted
+    bool closed;       // footer / ']' already emitted
+    char pending[192]; // one rendered event or msgpack block
+    size_t pendingLen;
+    size_t pendingPos;
+    TimestampFormatter timestamps; // converts once per local day
+};
@@ -0,0 +1,191 @@
+#include "Metrics.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// Handler latency bucket bounds, 1 ms to 1 s
+static const uint32_t bucketBoundsUs[METRICS_BUCKETS] = {1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000};
+
+// ===============================================================
+// MetricsWriter
+// ===============================================================
+
+MetricsWriter::MetricsWriter(char *buffer, size_t capacity) : buffer(buffer), capacity(capacity), used(0), full(false)
+{
+}
+
+void MetricsWriter::append(const char *fmt, ...)
+{
+  if (full)
+    return;
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buffer + used, capacity - used, fmt, args);
+  va_end(args);
+  // a line that does not fit is dropped whole, the buffer keeps complete lines
+  if (n > 0 && (size_t)n < capacity - used)
+    used += n;
+  else
+    full = true;
+}
+
+void MetricsWriter::family(const char *name, const char *type, const char *help)
+{
+  append("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void MetricsWriter::sample(const char *name, const char *labels, uint64_t value)
+{
+  if (labels)
+    append("%s{%s} %llu\n", name, labels, (unsigned long long)value);
+  else
+    append("%s %llu\n", name, (unsigned long long)value);
+}
+
+void MetricsWriter::sample(const char *name, const char *labels, double value)
+{
+  if (labels)
+    append("%s{%s} %.6f\n", name, labels, value);
+  else
+    append("%s %.6f\n", name, value);
+}
+
+void MetricsWriter::counter(const char *name, const char *help, uint64_t value)
+{
+  family(name, "counter", help);
+  sample(name, nullptr, value);
+}
+
+void MetricsWriter::gauge(const char *name, const char *help, uint64_t value)
+{
+  family(name, "gauge", help);
+  sample(name, nullptr, value);
+}
+
+// ===============================================================
+// Metrics
+// ===============================================================
+
+Metrics::Metrics() : routeCount(0), sectionCount(0), truncated(0)
+{
+  memset(routes, 0, sizeof(routes));
+  memset(sections, 0, sizeof(sections));
+}
+
+int Metrics::addRoute(const char *method, const char *path)
+{
+  if (routeCount >= METRICS_MAX_ROUTES)
+    return -1;
+  Route &r = routes[routeCount];
+  r.method = method;
+  r.path = path;
+  return (int)routeCount++;
+}
+
+void Metrics::observe(int route, uint32_t elapsedUs)
+{
+  if (route < 0 || (size_t)route >= routeCount)
+    return;
+  Route &r = routes[route];
+  size_t b = 0;
+  while (b < METRICS_BUCKETS && elapsedUs > bucketBoundsUs[b])
+    b++;
+  r.buckets[b]++;
+  r.count++;
+  r.sumUs += elapsedUs;
+}
+
+void Metrics::addSection(Section section, size_t parts)
+{
+  if (sectionCount < METRICS_MAX_SECTIONS)
+    sections[sectionCount++] = {section, parts};
+}
+
+// ===============================================================
+// MetricsStreamer
+// ===============================================================
+
+MetricsStreamer::MetricsStreamer(const Metrics &metrics)
+    : metrics(metrics), item(0), part(0), pendingLength(0), pendingOffset(0)
+{
+}
+
+bool MetricsStreamer::renderNext()
+{
+  MetricsWriter out(pending, sizeof(pending));
+  size_t sections = metrics.sectionCount;
+  size_t routes = metrics.routeCount;
+  char labels[96];
+  bool nextItem = true;
+
+  if (item < sections)
+  {
+    const Metrics::SectionEntry &section = metrics.sections[item];
+    section.render(out, part);
+    if (++part < section.parts)
+      nextItem = false;
+    else
+      part = 0;
+  }
+  else if (item == sections)
+  {
+    out.counter("garden_metrics_truncated_total", "Metric sections cut short because they did not fit the render buffer",
+                metrics.truncated);
+    out.family("http_requests_total", "counter", "Requests handled, by route");
+    for (size_t i = 0; i < routes; i++)
+    {
+      const Metrics::Route &r = metrics.routes[i];
+      snprintf(labels, sizeof(labels), "method=\"%s\",route=\"%s\"", r.method, r.path);
+      out.sample("http_requests_total", labels, (uint64_t)r.count);
+    }
+  }
+  else if (item <= sections + routes)
+  {
+    size_t i = item - sections - 1;
+    if (i == 0)
+      out.family("http_request_duration_seconds", "histogram", "Handler run time on the async_tcp task, by route");
+    const Metrics::Route &r = metrics.routes[i];
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b <= METRICS_BUCKETS; b++)
+    {
+      cumulative += r.buckets[b];
+      if (b < METRICS_BUCKETS)
+        snprintf(labels, sizeof(labels), "method=\"%s\",route=\"%s\",le=\"%g\"", r.method, r.path, bucketBoundsUs[b] / 1e6);
+      else
+        snprintf(labels, sizeof(labels), "method=\"%s\",route=\"%s\",le=\"+Inf\"", r.method, r.path);
+      out.sample("http_request_duration_seconds_bucket", labels, cumulative);
+    }
+    snprintf(labels, sizeof(labels), "method=\"%s\",route=\"%s\"", r.method, r.path);
+    out.sample("http_request_duration_seconds_sum", labels, r.sumUs / 1e6);
+    out.sample("http_request_duration_seconds_count", labels, (uint64_t)r.count);
+  }
+  else
+  {
+    return false;
+  }
+
+  if (out.truncated())
+    metrics.truncated++;
+  if (nextItem)
+    item++;
+  pendingLength = out.length();
+  pendingOffset = 0;
+  return true;
+}
+
+size_t MetricsStreamer::fill(uint8_t *buf, size_t maxLen)
+{
+  size_t written = 0;
+  while (written < maxLen)
+  {
+    if (pendingOffset == pendingLength && !renderNext())
+      break;
+    size_t n = pendingLength - pendingOffset;
+    if (n > maxLen - written)
+      n = maxLen - written;
+    memcpy(buf + written, pending + pendingOffset, n);
+    pendingOffset += n;
+    written += n;
+  }
+  return written;
+}
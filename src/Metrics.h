@@ -0,0 +1,107 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Runtime metrics for /metrics, Prometheus text format 0.0.4.
+//
+// Every route registered in setupServer() gets a request counter and a
+// latency histogram of its handler, i.e. the time spent on the async_tcp task
+// building the response (not the time to transmit it). Recording is a bucket
+// search over METRICS_BUCKETS bounds and a few increments; routes are only
+// observed and rendered on the async_tcp task, so they need no locking.
+// Everything else (heap, log, mutexes, watering) is rendered by sections
+// registered with addSection(), which read their module's counters when the
+// endpoint is scraped.
+//
+// The response is streamed: MetricsStreamer renders one section part or route
+// at a time into a small buffer, like LogStreamer does for /logs. A section
+// whose output grows with the number of modules (e.g. mutexes) is split into
+// parts, one metric family each, so every part stays well below the buffer.
+// Parts that still overflow are cut at a line boundary and counted in
+// garden_metrics_truncated_total.
+
+#define METRICS_MAX_ROUTES 24
+#define METRICS_MAX_SECTIONS 8
+#define METRICS_BUCKETS 10     // latency bucket bounds, plus +Inf
+#define METRICS_CHUNK_SIZE 2048 // per section part or route, overflow is counted
+
+// Prometheus text lines into a fixed buffer, output past capacity is dropped
+class MetricsWriter {
+public:
+    MetricsWriter(char *buffer, size_t capacity);
+
+    // "# HELP" and "# TYPE" lines, once per metric family before its samples
+    void family(const char *name, const char *type, const char *help);
+    // One sample, labels without braces (e.g. "mutex=\"log\"") or nullptr
+    void sample(const char *name, const char *labels, uint64_t value);
+    void sample(const char *name, const char *labels, double value);
+    // family() plus one unlabeled sample
+    void counter(const char *name, const char *help, uint64_t value);
+    void gauge(const char *name, const char *help, uint64_t value);
+
+    size_t length() const { return used; }
+    bool truncated() const { return full; }
+
+private:
+    void append(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+    char *buffer;
+    size_t capacity;
+    size_t used;
+    bool full; // a line did not fit, everything after it is dropped
+};
+
+class Metrics {
+public:
+    Metrics();
+
+    // Registers a route, returns its ID for observe(), -1 when the table is full
+    int addRoute(const char *method, const char *path);
+    void observe(int route, uint32_t elapsedUs);
+
+    // Renders part (0 .. parts - 1) of a section
+    typedef void (*Section)(MetricsWriter &out, size_t part);
+    void addSection(Section section, size_t parts = 1);
+
+private:
+    friend class MetricsStreamer;
+
+    struct Route {
+        const char *method;
+        const char *path;
+        uint32_t count;
+        uint64_t sumUs;
+        uint32_t buckets[METRICS_BUCKETS + 1]; // last one is +Inf
+    };
+
+    struct SectionEntry {
+        Section render;
+        size_t parts;
+    };
+
+    Route routes[METRICS_MAX_ROUTES];
+    size_t routeCount;
+    SectionEntry sections[METRICS_MAX_SECTIONS];
+    size_t sectionCount;
+    mutable uint32_t truncated; // rendered parts that did not fit, streamer only (async_tcp)
+};
+
+class MetricsStreamer {
+public:
+    explicit MetricsStreamer(const Metrics &metrics);
+
+    // Copies the next part of the text into buf, 0 when done
+    size_t fill(uint8_t *buf, size_t maxLen);
+
+    static const char *contentType() { return "text/plain; version=0.0.4"; }
+
+private:
+    bool renderNext(); // false when everything was rendered
+
+    const Metrics &metrics;
+    size_t item; // sections, then route counters, then one histogram per route
+    size_t part; // within the current section
+    char pending[METRICS_CHUNK_SIZE];
+    size_t pendingLength;
+    size_t pendingOffset;
+};
@@ -0,0 +1,146 @@
+#include "Scheduler.h"
+#include <stdlib.h>
+#include <algorithm>
+#include "ConfigManager.h"
+#include "LogManager.h"
+#include "SoilArchive.h"
+#include "WateringManager.h"
+
+extern ConfigManager config;
+extern LogManager logManager;
+extern SoilArchive archive;
+extern WateringManager watering;
+
+Scheduler::Scheduler() : compiled(false)
+{
+}
+
+bool Scheduler::begin()
+{
+  return hal::startTask(taskEntry, "SchedulerTask", 4096, this, 1, 1);
+}
+
+void Scheduler::taskEntry(void *param)
+{
+  ((Scheduler *)param)->run();
+}
+
+// Parses "HH:MM" into minute of day, -1 if malformed
+static int parseMinuteOfDay(const std::string &time)
+{
+  if (time.size() != 5 || time[2] != ':')
+    return -1;
+  int h = atoi(time.c_str());
+  int m = atoi(time.c_str() + 3);
+  if (h < 0 || h > 23 || m < 0 || m > 59)
+    return -1;
+  return h * 60 + m;
+}
+
+void Scheduler::compile()
+{
+  timeline.clear();
+  snapshot = config.get();
+
+  // soil logging during light cycle only (to prevent corrosion of soil sensors)
+  int startHour = (snapshot->lightStart - 1 + 24) % 24; // start one hour earlier
+  int endHour = snapshot->lightEnd;
+  int interval = snapshot->soilLogIntervalMin;
+  for (int hour = 0; interval > 0 && hour < 24; hour++)
+  {
+    bool inLightCycle = startHour < endHour ? (hour >= startHour && hour < endHour)
+                                            : (hour >= startHour || hour < endHour);
+    if (!inLightCycle)
+      continue;
+    for (int minute = 0; minute < 60; minute += interval)
+      timeline.push_back({(uint16_t)(hour * 60 + minute), SCHEDULE_SOIL, 0});
+  }
+
+  for (size_t i = 0; i < snapshot->wateringSchedules.size() && i <= UINT8_MAX; i++)
+  {
+    int minute = parseMinuteOfDay(snapshot->wateringSchedules[i].time);
+    if (minute >= 0)
+      timeline.push_back({(uint16_t)minute, SCHEDULE_WATERING, (uint8_t)i});
+  }
+
+  std::stable_sort(timeline.begin(), timeline.end());
+  compiled = true;
+  hal::logf("[Scheduler] Timeline compiled: %u entries\n", (unsigned)timeline.size());
+}
+
+void Scheduler::fire(int64_t epochMinute)
+{
+  time_t t = (time_t)(epochMinute * 60);
+  struct tm timeinfo;
+  localtime_r(&t, &timeinfo);
+  Entry key = {(uint16_t)(timeinfo.tm_hour * 60 + timeinfo.tm_min), 0, 0};
+
+  auto range = std::equal_range(timeline.begin(), timeline.end(), key);
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    if (it->kind == SCHEDULE_SOIL)
+    {
+      if (soilHook)
+        soilHook();
+    }
+    else
+    {
+      // queued behind a running job instead of being dropped
+      // schedules keep durations, they are watered as the volume that time delivers
+      const WateringSchedule &ws = snapshot->wateringSchedules[it->index];
+      int volumes[WATERING_VALVES];
+      watering.volumesFor(ws.durations.data(), volumes);
+      if (!watering.enqueue(volumes, WATERING_SOURCE_SCHEDULE))
+        hal::logf("[Scheduler] Watering queue full, schedule %s skipped\n", ws.time.c_str());
+    }
+  }
+}
+
+uint32_t Scheduler::msUntilNext(time_t now) const
+{
+  if (timeline.empty())
+    return SCHEDULER_MAX_SLEEP_MS;
+
+  struct tm timeinfo;
+  localtime_r(&now, &timeinfo);
+  Entry key = {(uint16_t)(timeinfo.tm_hour * 60 + timeinfo.tm_min), 0, 0};
+  auto next = std::upper_bound(timeline.begin(), timeline.end(), key);
+  int minute = next != timeline.end() ? next->minute : timeline.front().minute + 24 * 60;
+
+  int64_t seconds = (int64_t)(minute - key.minute) * 60 - timeinfo.tm_sec;
+  // half a second late, so the wakeup never lands in the previous minute
+  uint64_t ms = seconds * 1000 + 500;
+  return ms < SCHEDULER_MAX_SLEEP_MS ? (uint32_t)ms : SCHEDULER_MAX_SLEEP_MS;
+}
+
+void Scheduler::run()
+{
+  // the current minute is still due at boot
+  int64_t lastMinute = hal::now() / 60 - 1;
+  for (;;)
+  {
+    if (!compiled || config.getVersion() != snapshot->version)
+      compile();
+
+    time_t now = hal::now();
+    int64_t nowMinute = now / 60;
+    int64_t missed = nowMinute - lastMinute;
+    if (missed > SCHEDULER_CATCHUP_MIN || -missed > SCHEDULER_CATCHUP_MIN)
+    {
+      hal::logf("[Scheduler] Clock jumped by %d min, resynchronizing\n", (int)missed);
+      lastMinute = nowMinute - 1;
+    }
+    // after a small backward jump nothing fires until the clock passes lastMinute again
+    for (int64_t m = lastMinute + 1; m <= nowMinute; m++)
+      fire(m);
+    if (nowMinute > lastMinute)
+      lastMinute = nowMinute;
+
+    // write batched events to flash when a batch is full or old enough
+    logManager.sync();
+    // past days go to the archive once they are over
+    archive.rollover(logManager, now);
+
+    wake.wait(msUntilNext(now));
+  }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+#include "ConfigManager.h"
+#include "hal/Hal.h"
+
+// Time-of-day scheduler for soil logging and watering.
+//
+// config.wateringSchedules and the soil logging window (light cycle, starting
+// one hour early, every soilLogIntervalMin minutes of the hour) are compiled
+// into one timeline sorted by minute of day. The task sleeps until the next
+// entry is due and recompiles only when the config version changes; reload()
+// wakes it early after an API change. The timeline keeps the config snapshot
+// it was compiled from, so schedule indices always refer to that snapshot.
+// Minutes are tracked as absolute epoch minutes, so every due minute fires
+// exactly once: small forward clock jumps (NTP) are caught up, backward jumps
+// do not repeat minutes already handled. Jumps beyond SCHEDULER_CATCHUP_MIN
+// resynchronize without replaying, so watering never runs hours late.
+// Every wakeup also flushes the event journal and archives finished days
+// (SoilArchive), both may block on flash.
+
+#define SCHEDULER_CATCHUP_MIN 10            // max missed minutes replayed after a clock jump
+#define SCHEDULER_MAX_SLEEP_MS (5 * 60 * 1000) // also the journal flush period
+
+typedef enum
+{
+  SCHEDULE_SOIL,     //!< full soil sensor sweep
+  SCHEDULE_WATERING  //!< watering job, index into config.wateringSchedules
+} schedule_kind_t;
+
+class Scheduler {
+public:
+    Scheduler();
+
+    // Starts the scheduler task (pinned to core 1)
+    bool begin();
+    // Config changed: recompile and recompute the next wakeup now
+    void reload() { wake.give(); }
+
+    // Soil sweep action, called from the scheduler task, must not block for long. Set before begin().
+    typedef void (*SoilHook)();
+    void setSoilHook(SoilHook hook) { soilHook = hook; }
+
+private:
+    struct Entry {
+        uint16_t minute; // minute of day, local time
+        uint8_t kind;    // schedule_kind_t
+        uint8_t index;   // watering schedule index
+        bool operator<(const Entry &other) const { return minute < other.minute; }
+    };
+
+    static void taskEntry(void *param);
+    void run();
+    void compile();
+    void fire(int64_t epochMinute);
+    uint32_t msUntilNext(time_t now) const;
+
+    hal::Signal wake;
+    std::vector<Entry> timeline; // sorted by minute, rebuilt only on config change
+    ConfigRef snapshot;          // config the timeline was compiled from
+    bool compiled;
+    SoilHook soilHook = nullptr;
+};
@@ -0,0 +1,207 @@
+#include "SensorManager.h"
+#include <string.h>
+#include "ConfigManager.h"
+#include "LogManager.h"
+#include "SoilStats.h"
+#include "hal/Hal.h"
+
+extern uint16_t soilReadingsLast[4];
+extern SoilStats soilStats;
+extern ConfigManager config;
+extern LogManager logManager;
+extern volatile bool pumpActive;
+
+void logDebug(const String &msg);
+
+// Settle time plus averaging: well under a second per group, seconds for a full sweep
+const uint32_t SensorStats::bucketBoundsMs[SENSOR_DURATION_BUCKETS] = {250, 500, 1000, 2000, 5000, 10000, 30000};
+
+SensorManager::SensorManager(const int *powerPins, const int *adcPins)
+    : powerPins(powerPins), adcPins(adcPins), queue(NULL), lastJobId(0), activeJobId(0), doneJobId(0), skippedJobs(0)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool SensorManager::begin()
+{
+  queue = xQueueCreate(SENSOR_QUEUE_LENGTH, sizeof(Command));
+  if (!queue)
+    return false;
+  return hal::startTask(taskEntry, "SensorTask", 4096, this, 1, 1);
+}
+
+bool SensorManager::read(uint8_t mask, bool skipIfPumpActive)
+{
+  Command cmd = {mask, skipIfPumpActive, 0, xTaskGetCurrentTaskHandle()};
+  if (xQueueSend(queue, &cmd, portMAX_DELAY) != pdTRUE)
+    return false;
+  uint32_t bits = 0;
+  // other notification bits of the caller are left untouched
+  while (!(bits & SENSOR_NOTIFY_BIT))
+    xTaskNotifyWait(0, SENSOR_NOTIFY_BIT, &bits, portMAX_DELAY);
+  return true;
+}
+
+uint32_t SensorManager::requestSweep()
+{
+  uint32_t id = 0;
+  if (jobMutex.lock())
+  {
+    if (activeJobId)
+    {
+      id = activeJobId; // coalesce onto queued or running sweep
+    }
+    else
+    {
+      Command cmd = {(uint8_t)((1 << SENSOR_COUNT) - 1), true, lastJobId + 1, NULL};
+      if (xQueueSend(queue, &cmd, 0) == pdTRUE)
+        id = activeJobId = ++lastJobId;
+    }
+    jobMutex.unlock();
+  }
+  return id;
+}
+
+sensor_job_state_t SensorManager::getJobState(uint32_t jobId) const
+{
+  sensor_job_state_t state = SENSOR_JOB_UNKNOWN;
+  if (jobMutex.lock())
+  {
+    if (jobId != 0 && jobId <= lastJobId)
+    {
+      uint32_t done = doneJobId.load();
+      uint32_t age = done - jobId;
+      if (jobId > done)
+        state = SENSOR_JOB_PENDING;
+      else if (age < 32 && (skippedJobs >> age) & 1)
+        state = SENSOR_JOB_SKIPPED;
+      else
+        state = SENSOR_JOB_DONE;
+    }
+    jobMutex.unlock();
+  }
+  return state;
+}
+
+SensorStats SensorManager::getStats() const
+{
+  SensorStats s;
+  memset(&s, 0, sizeof(s));
+  if (jobMutex.lock())
+  {
+    s = stats;
+    jobMutex.unlock();
+  }
+  return s;
+}
+
+void SensorManager::taskEntry(void *param)
+{
+  ((SensorManager *)param)->run();
+}
+
+void SensorManager::run()
+{
+  Command cmd;
+  for (;;)
+  {
+    if (xQueueReceive(queue, &cmd, portMAX_DELAY) != pdTRUE)
+      continue;
+
+    // skipping soil read if watering is active
+    // to prevent false readings due to water in soil
+    // also to prevent power supply dips
+    bool skipped = cmd.skipIfPumpActive && pumpActive;
+    uint64_t elapsedUs = 0;
+    if (skipped)
+    {
+      logDebug("Pump active, skipping soil sensor read");
+    }
+    else
+    {
+      uint64_t start = hal::uptimeUs();
+      acquire(cmd.mask);
+      elapsedUs = hal::uptimeUs() - start;
+    }
+
+    if (jobMutex.lock())
+    {
+      if (skipped)
+      {
+        stats.skipped++;
+      }
+      else
+      {
+        size_t b = 0;
+        while (b < SENSOR_DURATION_BUCKETS && elapsedUs > SensorStats::bucketBoundsMs[b] * 1000ULL)
+          b++;
+        stats.buckets[b]++;
+        stats.acquisitions++;
+        stats.acquireUs += elapsedUs;
+      }
+      if (cmd.jobId)
+      {
+        if (activeJobId == cmd.jobId)
+          activeJobId = 0;
+        skippedJobs = (skippedJobs << 1) | (skipped ? 1 : 0);
+        doneJobId.store(cmd.jobId);
+      }
+      jobMutex.unlock();
+    }
+    if (cmd.waiter)
+      xTaskNotify(cmd.waiter, SENSOR_NOTIFY_BIT, eSetBits);
+  }
+}
+
+void SensorManager::acquire(uint8_t mask)
+{
+  int selected[SENSOR_COUNT];
+  int count = 0;
+  for (int i = 0; i < SENSOR_COUNT; i++)
+  {
+    if (mask & (1 << i))
+      selected[count++] = i;
+  }
+
+  // one config snapshot for the whole sweep
+  ConfigRef cfg = config.get();
+  int groupSize = constrain(cfg->sensorGroupSize, 1, SENSOR_COUNT);
+  for (int g = 0; g < count; g += groupSize)
+    readGroup(*cfg, selected + g, min(groupSize, count - g));
+}
+
+// Powers a group of sensors together, waits one shared settle period and
+// samples the channels round-robin, so a group costs the same wall clock
+// and relay-on time as a single sensor did.
+void SensorManager::readGroup(const ConfigData &cfg, const int *ids, int n)
+{
+  // powering up 5V sensors (active LOW)
+  for (int k = 0; k < n; k++)
+    hal::pinWrite(powerPins[ids[k]], false);
+  // dalying to let sensors settle after powering up
+  hal::sleepMs(cfg.sensorSettleTime);
+
+  long sum[SENSOR_COUNT] = {0};
+  for (int j = 0; j < cfg.soilSensorCounter; j++)
+  {
+    // reading sensors multiple times and averaging, interleaved across channels
+    for (int k = 0; k < n; k++)
+      sum[k] += hal::adcRead(adcPins[ids[k]]);
+    hal::sleepMs(50);
+  }
+
+  // powering down 5V sensors
+  for (int k = 0; k < n; k++)
+    hal::pinWrite(powerPins[ids[k]], true);
+
+  // logged in sensor order, same as one-by-one reads
+  uint32_t now = hal::now();
+  for (int k = 0; k < n; k++)
+  {
+    int sensorId = ids[k];
+    int value = sum[k] / cfg.soilSensorCounter;
+    soilReadingsLast[sensorId] = value;
+    soilStats.add(sensorId, now, value, cfg.lightStart, cfg.lightEnd);
+    logManager.addSoilEvent(sensorId, value);
+  }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "ConfigManager.h"
+#include "hal/Hal.h"
+
+// Soil sensor acquisition engine.
+//
+// A dedicated task owns the sensor power relays and the ADC and executes
+// acquisition commands from a queue, so slow sensor reads (settle time plus
+// averaging, seconds per sweep) never run on the caller's task.
+// Tasks that need the result wait for it (read()), HTTP handlers start an
+// asynchronous sweep and poll its job ID (requestSweep() / getJobState());
+// concurrent asynchronous requests coalesce onto the sweep already queued or
+// running.
+// Sensors are powered in groups of config.sensorGroupSize that share one
+// settle period and are sampled interleaved.
+
+#define SENSOR_COUNT 4
+#define SENSOR_QUEUE_LENGTH 4
+#define SENSOR_NOTIFY_BIT (1u << 0) // task notification bit used to signal read() callers
+#define SENSOR_DURATION_BUCKETS 7   // acquisition time bucket bounds, plus +Inf
+
+typedef enum
+{
+  SENSOR_JOB_UNKNOWN, //!< Never issued (or ID out of range)
+  SENSOR_JOB_PENDING, //!< Queued or running
+  SENSOR_JOB_DONE,    //!< Finished, readings are in soilReadingsLast
+  SENSOR_JOB_SKIPPED  //!< Finished without reading, pump was active
+} sensor_job_state_t;
+
+// Counters since boot, for /metrics
+struct SensorStats {
+    uint32_t acquisitions; // reads and sweeps that powered sensors
+    uint32_t skipped;      // not run because the pump was active
+    uint64_t acquireUs;    // total acquisition time
+    uint32_t buckets[SENSOR_DURATION_BUCKETS + 1]; // acquisitions per duration bucket, last one is +Inf
+    static const uint32_t bucketBoundsMs[SENSOR_DURATION_BUCKETS];
+};
+
+class SensorManager {
+public:
+    SensorManager(const int *powerPins, const int *adcPins);
+
+    // Creates the command queue and the acquisition task (pinned to core 1)
+    bool begin();
+
+    // Reads sensors in mask and waits for completion. Call from tasks only, not from HTTP handlers.
+    // With skipIfPumpActive the sweep is skipped while watering (wet soil, supply dips).
+    bool read(uint8_t mask, bool skipIfPumpActive);
+
+    // Starts (or joins) an asynchronous full sweep, never blocks. Returns job ID, 0 if queue is full.
+    uint32_t requestSweep();
+    sensor_job_state_t getJobState(uint32_t jobId) const;
+
+    SensorStats getStats() const;
+    hal::MutexStats getMutexStats() const { return jobMutex.getStats(); }
+
+private:
+    struct Command {
+        uint8_t mask;
+        bool skipIfPumpActive;
+        uint32_t jobId;       // async job, 0 for blocking reads
+        TaskHandle_t waiter;  // notified on completion, blocking reads only
+    };
+
+    static void taskEntry(void *param);
+    void run();
+    void acquire(uint8_t mask);
+    void readGroup(const ConfigData &cfg, const int *ids, int n);
+
+    const int *powerPins;
+    const int *adcPins;
+    QueueHandle_t queue;
+    mutable hal::Mutex jobMutex;       // guards async job bookkeeping and stats
+    uint32_t lastJobId;                // last issued async job
+    uint32_t activeJobId;              // async sweep queued or running, 0 if none
+    std::atomic<uint32_t> doneJobId;   // last finished async job
+    // bit k set: job doneJobId - k was skipped; async jobs finish in ID order
+    // because a new one is only issued once the active one is done
+    uint32_t skippedJobs;
+    SensorStats stats;
+};
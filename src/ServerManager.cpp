@@ -1,24 +1,610 @@
 #include "ServerManager.h"
 #include "ConfigManager.h"
+#include "JsonArena.h"
 #include "LogManager.h"
+#include "LogStreamer.h"
+#include "Metrics.h"
+#include "SensorManager.h"
+#include "SoilArchive.h"
+#include "SoilStats.h"
+#include "WateringManager.h"
+#include "Scheduler.h"
 #include <WiFi.h>
+#include <LittleFS.h>
 #include <ArduinoJson.h>
 #include <time.h>
+#include <memory>
 
 extern uint16_t soilReadingsLast[4];
-extern uint16_t soilReadingsMax[4];
-extern uint16_t soilReadingsMin[4];
+extern SoilStats soilStats;
+extern SoilArchive archive;
 extern ConfigManager config;
 extern LogManager logManager;
 extern volatile bool pumpActive;
 
-// forward declarations from main.cpp
-void readSoilSensors();
-void wateringCycle(int duration0, int duration1, int duration2, int duration3);
+extern SensorManager sensors;
+extern WateringManager watering;
+extern Scheduler scheduler;
+extern JsonPool jsonPool;
+
+static Metrics metrics;
+// Config version and log sequence restart on every boot, so ETags also carry
+// this value to keep a pre-reboot tag from matching different content
+static uint32_t bootNonce;
+
+static float round2(float value)
+{
+  return roundf(value * 100) / 100;
+}
+
+static void addSoilCycle(JsonObject obj, const SoilCycle &cycle)
+{
+  obj["light"] = cycle.light;
+  obj["start"] = cycle.start;
+  if (cycle.end)
+    obj["end"] = cycle.end;
+  JsonArray sensors = obj["sensors"].to<JsonArray>();
+  for (int i = 0; i < SOIL_STATS_SENSORS; i++)
+  {
+    const SoilSummary &s = cycle.sensors[i];
+    JsonObject o = sensors.add<JsonObject>();
+    o["count"] = s.count;
+    if (!s.count)
+      continue;
+    o["last"] = s.last;
+    o["min"] = s.min;
+    o["max"] = s.max;
+    o["mean"] = round2(s.mean);
+    o["stddev"] = round2(s.stddev);
+    o["ewma"] = round2(s.ewma);
+    o["slope"] = round2(s.slope);
+  }
+}
+
+static const char *wateringJobStateName(watering_job_state_t state)
+{
+  switch (state)
+  {
+  case WATERING_JOB_QUEUED:
+    return "queued";
+  case WATERING_JOB_RUNNING:
+    return "running";
+  case WATERING_JOB_DONE:
+    return "done";
+  case WATERING_JOB_CANCELLED:
+    return "cancelled";
+  default:
+    return "unknown";
+  }
+}
+
+// Parses a time query parameter: epoch seconds or local 'YYYY-MM-DD HH:MM[:SS]' (also with 'T')
+static bool parseTime(const String &value, time_t &out)
+{
+  const char *str = value.c_str();
+  char *end;
+  unsigned long epoch = strtoul(str, &end, 10);
+  if (*str && *end == '\0')
+  {
+    out = epoch;
+    return true;
+  }
+  struct tm tm = {};
+  int n = sscanf(str, "%d-%d-%d%*c%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+  if (n < 3)
+    return false;
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  tm.tm_isdst = -1;
+  out = mktime(&tm);
+  return out != (time_t)-1;
+}
+
+// Parses comma separated event type names, a trailing '*' matches by prefix (e.g. WATERING_*)
+static bool parseTypeMask(const String &value, uint32_t &mask)
+{
+  mask = 0;
+  int start = 0;
+  while (start <= (int)value.length())
+  {
+    int comma = value.indexOf(',', start);
+    if (comma < 0)
+      comma = value.length();
+    String token = value.substring(start, comma);
+    token.trim();
+    bool prefix = token.endsWith("*");
+    if (prefix)
+      token.remove(token.length() - 1);
+    bool matched = false;
+    for (int t = 0; t < EVENT_TYPE_COUNT; t++)
+    {
+      const char *name = logManager.getEventTypeName((event_type_t)t);
+      if (prefix ? strncmp(name, token.c_str(), token.length()) == 0 : token == name)
+      {
+        mask |= 1u << t;
+        matched = true;
+      }
+    }
+    if (!matched)
+      return false;
+    start = comma + 1;
+  }
+  return true;
+}
+
+// Builds LogQuery from /logs parameters, returns error message or nullptr
+static const char *parseLogQuery(AsyncWebServerRequest *request, LogQuery &query)
+{
+  if (request->hasParam("from") && !parseTime(request->getParam("from")->value(), query.from))
+    return "Invalid from, use epoch seconds or YYYY-MM-DD HH:MM:SS";
+  if (request->hasParam("to") && !parseTime(request->getParam("to")->value(), query.to))
+    return "Invalid to, use epoch seconds or YYYY-MM-DD HH:MM:SS";
+  if (request->hasParam("type") && !parseTypeMask(request->getParam("type")->value(), query.typeMask))
+    return "Unknown event type";
+  if (request->hasParam("offset"))
+    query.offset = max(0L, request->getParam("offset")->value().toInt());
+  if (request->hasParam("limit"))
+    query.limit = max(0L, request->getParam("limit")->value().toInt());
+  if (request->hasParam("ts")) {
+    const String &ts = request->getParam("ts")->value();
+    if (ts != "epoch" && ts != "local")
+      return "ts must be epoch or local";
+    query.epochTimestamps = ts == "epoch";
+  }
+  return nullptr;
+}
+
+// --- /events live stream (Server-Sent Events) ---
+// Library queue per client is bounded by SSE_MAX_QUEUED_MESSAGES (platformio.ini),
+// a client that falls further behind misses events instead of being buffered for.
+// Nothing is formatted while nobody listens.
+#define EVENTS_MAX_CLIENTS 4
+
+static AsyncEventSource events("/events");
+// Only touched from connect/disconnect callbacks, which all run on async_tcp.
+// Producers never look at clients: closing one from their task would run the
+// disconnect path outside async_tcp.
+static AsyncEventSourceClient *eventClients[EVENTS_MAX_CLIENTS];
+
+static void publish(const char *name, const char *data)
+{
+  if (events.count() == 0)
+    return;
+  events.send(data, name);
+}
+
+static void publishEvent(const Event &event)
+{
+  if (events.count() == 0)
+    return;
+  char data[96];
+  snprintf(data, sizeof(data), "{\"timestamp\":%lu,\"eventType\":\"%s\",\"value\":%u}",
+           (unsigned long)event.timestamp, logManager.getEventTypeName(event.eventType), event.value);
+  publish("log", data);
+}
+
+void publishPumpState(bool active)
+{
+  publish("pump", active ? "{\"pumpActive\":true}" : "{\"pumpActive\":false}");
+}
+
+static void setupEvents()
+{
+  events.onConnect([](AsyncEventSourceClient *client)
+                   {
+    bool accepted = false;
+    for (AsyncEventSourceClient *&slot : eventClients)
+    {
+      if (!slot)
+      {
+        slot = client;
+        accepted = true;
+        break;
+      }
+    }
+    if (!accepted)
+    {
+      client->close();
+      return;
+    }
+    // current pump state so the client does not have to poll /status first
+    client->send(pumpActive ? "{\"pumpActive\":true}" : "{\"pumpActive\":false}", "pump"); });
+
+  events.onDisconnect([](AsyncEventSourceClient *client)
+                      {
+    for (AsyncEventSourceClient *&slot : eventClients)
+      if (slot == client)
+        slot = nullptr; });
+
+  server.addHandler(&events);
+  logManager.setListener(publishEvent);
+}
+
+// Picks response format from Accept header, ?format=json|csv|msgpack overrides it
+static response_format_t negotiateFormat(AsyncWebServerRequest *request)
+{
+  String accept;
+  if (request->hasParam("format"))
+    accept = request->getParam("format")->value();
+  else if (request->hasHeader("Accept"))
+    accept = request->header("Accept");
+  if (accept.indexOf("msgpack") >= 0)
+    return FORMAT_MSGPACK;
+  if (accept.indexOf("csv") >= 0)
+    return FORMAT_CSV;
+  return FORMAT_JSON;
+}
+
+// Flattens a flat JSON object into a header row and a value row, arrays become key_0..key_n columns
+static void writeCsv(Print &out, JsonObjectConst obj)
+{
+  for (int row = 0; row < 2; row++)
+  {
+    bool first = true;
+    for (JsonPairConst kv : obj)
+    {
+      JsonArrayConst arr = kv.value().as<JsonArrayConst>();
+      size_t n = arr.isNull() ? 1 : arr.size();
+      for (size_t i = 0; i < n; i++)
+      {
+        if (!first)
+          out.print(',');
+        first = false;
+        if (row == 0)
+        {
+          out.print(kv.key().c_str());
+          if (!arr.isNull())
+            out.printf("_%u", (unsigned)i);
+        }
+        else
+        {
+          serializeJson(arr.isNull() ? kv.value() : arr[i], out);
+        }
+      }
+    }
+    out.print('\n');
+  }
+}
+
+// Print into a fixed buffer, counts what did not fit (pass no buffer to measure)
+class BufferPrint : public Print {
+public:
+  BufferPrint(uint8_t *buffer, size_t capacity) : buffer(buffer), capacity(capacity), length(0) {}
+  size_t write(uint8_t c) override
+  {
+    if (length < capacity)
+      buffer[length] = c;
+    length++;
+    return 1;
+  }
+  size_t written() const { return length; }
+
+private:
+  uint8_t *buffer;
+  size_t capacity;
+  size_t length;
+};
+
+// Serializes a document in the given format, returns the length,
+// or without a buffer the capacity needed
+static size_t serializeDocument(JsonDocument &doc, response_format_t format, uint8_t *buffer, size_t capacity)
+{
+  if (format == FORMAT_MSGPACK)
+    return buffer ? serializeMsgPack(doc, buffer, capacity) : measureMsgPack(doc);
+  if (format == FORMAT_CSV)
+  {
+    BufferPrint out(buffer, capacity);
+    writeCsv(out, doc.as<JsonObjectConst>());
+    return out.written();
+  }
+  // +1, serializeJson always leaves room for a terminator
+  return buffer ? serializeJson(doc, buffer, capacity) : measureJson(doc) + 1;
+}
+
+// Response with a body serialized into a JsonPool block, which goes back to
+// the pool when the server deletes the response after sending it
+class PooledResponse : public AsyncAbstractResponse {
+public:
+  PooledResponse(int code, JsonDocument &doc, response_format_t format)
+      : buffer(serializeDocument(doc, format, nullptr, 0)), sent(0)
+  {
+    _code = code;
+    _contentType = LogStreamer::contentType(format);
+    _contentLength = buffer.ok() ? serializeDocument(doc, format, buffer.data(), buffer.capacity()) : 0;
+  }
+  bool _sourceValid() const override { return buffer.ok(); }
+  size_t _fillBuffer(uint8_t *data, size_t maxLen) override
+  {
+    size_t n = _contentLength - sent < maxLen ? _contentLength - sent : maxLen;
+    memcpy(data, buffer.data() + sent, n);
+    sent += n;
+    return n;
+  }
+
+private:
+  JsonBuffer buffer;
+  size_t sent;
+};
+
+// Sends a document in the negotiated format, with ETag if given
+static void sendDocument(AsyncWebServerRequest *request, JsonDocument &doc, response_format_t format, const char *etag = nullptr)
+{
+  AsyncWebServerResponse *response = new PooledResponse(200, doc, format);
+  if (etag)
+  {
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+  }
+  response->addHeader("Vary", "Accept");
+  request->send(response);
+}
+
+// Answers 304 if the client already has this representation
+static bool sendIfNotModified(AsyncWebServerRequest *request, const String &etag)
+{
+  if (request->hasHeader("If-None-Match") && request->header("If-None-Match") == etag)
+  {
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    response->addHeader("ETag", etag);
+    request->send(response);
+    return true;
+  }
+  return false;
+}
+
+static void sendWithETag(AsyncWebServerRequest *request, const String &json, const String &etag)
+{
+  AsyncWebServerResponse *response = request->beginResponse(200, "application/json", json);
+  response->addHeader("ETag", etag);
+  response->addHeader("Cache-Control", "no-cache"); // may be cached, must revalidate
+  request->send(response);
+}
+
+// Serialized config, regenerated only when ConfigManager version changes
+static const String &getConfigJson()
+{
+  static String json;
+  static uint32_t cachedVersion = 0;
+  static bool valid = false;
+  ConfigRef cfg = config.get();
+  if (valid && cachedVersion == cfg->version)
+    return json;
+
+  JsonArena arena;
+  JsonDocument doc(&arena);
+  doc["mode"] = cfg->mode;
+  doc["lightStart"] = cfg->lightStart;
+  doc["lightEnd"] = cfg->lightEnd;
+  doc["sensorSettleTime"] = cfg->sensorSettleTime;
+  doc["soilLogIntervalMin"] = cfg->soilLogIntervalMin;
+  doc["soilSensorCounter"] = cfg->soilSensorCounter;
+  doc["sensorGroupSize"] = cfg->sensorGroupSize;
+
+  JsonArray arr = doc["wateringSchedules"].to<JsonArray>();
+  for (auto &ws : cfg->wateringSchedules) {
+    JsonObject obj = arr.add<JsonObject>();
+    obj["time"] = ws.time;
+    JsonArray d = obj["durations"].to<JsonArray>();
+    for (int v = 0; v < 4; v++) d.add(ws.durations[v]);
+  }
+
+  json = "";
+  serializeJson(doc, json);
+  cachedVersion = cfg->version;
+  valid = true;
+  return json;
+}
+
+static String getConfigETag()
+{
+  char etag[24];
+  snprintf(etag, sizeof(etag), "\"c%x-%x\"", (unsigned)bootNonce, (unsigned)config.getVersion());
+  return etag;
+}
+
+// Parts of /status that never change while running, computed on first request
+struct StaticStatus {
+  String wifi;
+  String lastResetReason;
+  uint32_t flashChipSize;
+  uint32_t sketchSize;
+  uint32_t freeSketchSpace;
+};
+
+static const StaticStatus &getStaticStatus()
+{
+  static StaticStatus status;
+  static bool valid = false;
+  if (!valid)
+  {
+    status.wifi = WiFi.SSID();
+    status.lastResetReason = String(esp_reset_reason());
+    status.flashChipSize = ESP.getFlashChipSize();
+    status.sketchSize = ESP.getSketchSize(); // walks the app image, slow
+    status.freeSketchSpace = ESP.getFreeSketchSpace();
+    valid = true;
+  }
+  return status;
+}
+
+static const char *methodName(WebRequestMethodComposite method)
+{
+  switch (method)
+  {
+  case HTTP_GET:
+    return "GET";
+  case HTTP_POST:
+    return "POST";
+  case HTTP_PUT:
+    return "PUT";
+  case HTTP_DELETE:
+    return "DELETE";
+  default:
+    return "ANY";
+  }
+}
+
+// server.on() that records request count and handler run time for /metrics
+static AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction handler)
+{
+  int route = metrics.addRoute(methodName(method), uri);
+  return server.on(uri, method, [route, handler](AsyncWebServerRequest *request)
+                   {
+                     uint64_t start = hal::uptimeUs();
+                     handler(request);
+                     metrics.observe(route, (uint32_t)(hal::uptimeUs() - start)); });
+}
+
+// Same for routes with a request body, where the body handler does the work
+// (observed once per body chunk, a single one for the small bodies used here)
+static AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                                   ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody)
+{
+  int route = metrics.addRoute(methodName(method), uri);
+  return server.on(uri, method, onRequest, onUpload,
+                   [route, onBody](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+                   {
+                     uint64_t start = hal::uptimeUs();
+                     onBody(request, data, len, index, total);
+                     metrics.observe(route, (uint32_t)(hal::uptimeUs() - start)); });
+}
+
+// --- /metrics sections, each reads its module's counters when scraped ---
+
+static void heapMetrics(MetricsWriter &out, size_t)
+{
+  hal::HeapStats heap = hal::heapStats();
+  out.gauge("garden_uptime_seconds", "Time since boot", hal::uptimeUs() / 1000000);
+  out.gauge("garden_heap_free_bytes", "Free internal heap", heap.freeBytes);
+  out.gauge("garden_heap_min_free_bytes", "Lowest free internal heap since boot", heap.minFreeBytes);
+  out.gauge("garden_heap_largest_free_block_bytes", "Largest possible internal allocation, shrinks with fragmentation", heap.largestFreeBlock);
+  out.gauge("garden_psram_free_bytes", "Free PSRAM", heap.psramFreeBytes);
+
+  JsonPoolStats pool = jsonPool.getStats();
+  out.gauge("garden_json_pool_blocks", "Handler JSON memory blocks", pool.blocks);
+  out.gauge("garden_json_pool_blocks_in_use", "Handler JSON memory blocks lent out", pool.inUse);
+  out.gauge("garden_json_pool_blocks_peak", "Most blocks lent out at once", pool.peakInUse);
+  out.counter("garden_json_pool_exhausted_total", "Requests for a block while all were lent out", pool.exhausted);
+  out.counter("garden_json_pool_overflows_total", "JSON allocations served by the heap", pool.overflows);
+}
+
+static void logMetrics(MetricsWriter &out, size_t)
+{
+  LogStats log = logManager.getStats();
+  out.counter("garden_log_events_pushed_total", "Events produced", log.pushed);
+  out.counter("garden_log_staging_dropped_total", "Events lost to a full staging ring", log.stagingDropped);
+  out.counter("garden_log_journal_dropped_total", "Events not journaled to flash", log.journalDropped);
+  out.gauge("garden_log_events", "Events held in the log", log.events);
+}
+
+// One family per part, so the section does not grow with the number of mutexes
+static const struct
+{
+  const char *name;
+  const char *type;
+  const char *help;
+  double (*value)(const hal::MutexStats &s);
+} mutexFamilies[] = {
+    {"garden_mutex_acquisitions_total", "counter", "Mutex acquisitions", [](const hal::MutexStats &s) { return (double)s.acquisitions; }},
+    {"garden_mutex_contended_total", "counter", "Acquisitions that had to wait", [](const hal::MutexStats &s) { return (double)s.contended; }},
+    {"garden_mutex_wait_seconds_total", "counter", "Time spent waiting for the mutex", [](const hal::MutexStats &s) { return s.waitUs / 1e6; }},
+    {"garden_mutex_hold_seconds_total", "counter", "Time the mutex was held", [](const hal::MutexStats &s) { return s.holdUs / 1e6; }},
+    {"garden_mutex_max_wait_seconds", "gauge", "Longest wait since boot", [](const hal::MutexStats &s) { return s.maxWaitUs / 1e6; }},
+    {"garden_mutex_max_hold_seconds", "gauge", "Longest hold since boot", [](const hal::MutexStats &s) { return s.maxHoldUs / 1e6; }},
+};
+
+static void mutexMetrics(MetricsWriter &out, size_t part)
+{
+  static const char *names[] = {"log", "journal", "journal_io", "watering", "sensor_jobs", "json_pool", "soil_stats"};
+  hal::MutexStats stats[] = {logManager.getMutexStats(), logManager.getJournalMutexStats(), logManager.getJournalIoMutexStats(),
+                             watering.getMutexStats(), sensors.getMutexStats(), jsonPool.getMutexStats(),
+                             soilStats.getMutexStats()};
+  const auto &f = mutexFamilies[part];
+  char labels[24];
+  out.family(f.name, f.type, f.help);
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+  {
+    snprintf(labels, sizeof(labels), "mutex=\"%s\"", names[i]);
+    out.sample(f.name, labels, f.value(stats[i]));
+  }
+}
+
+static void wateringMetrics(MetricsWriter &out, size_t)
+{
+  WateringStats stats = watering.getStats();
+  out.family("garden_watering_jobs_total", "counter", "Watering jobs by outcome");
+  out.sample("garden_watering_jobs_total", "result=\"accepted\"", (uint64_t)stats.accepted);
+  out.sample("garden_watering_jobs_total", "result=\"rejected\"", (uint64_t)stats.rejected);
+  out.sample("garden_watering_jobs_total", "result=\"done\"", (uint64_t)stats.done);
+  out.sample("garden_watering_jobs_total", "result=\"cancelled\"", (uint64_t)stats.cancelled);
+  out.gauge("garden_watering_jobs_queued", "Jobs waiting for the pump", watering.getStatus().queued);
+
+  char labels[16];
+  out.family("garden_watering_seconds_total", "counter", "Time each valve was open");
+  for (int v = 0; v < WATERING_VALVES; v++)
+  {
+    snprintf(labels, sizeof(labels), "valve=\"%d\"", v);
+    out.sample("garden_watering_seconds_total", labels, (uint64_t)stats.wateredSec[v]);
+  }
+  out.family("garden_watering_volume_ml_total", "counter", "Water delivered per valve at the calibrated flow rate");
+  for (int v = 0; v < WATERING_VALVES; v++)
+  {
+    snprintf(labels, sizeof(labels), "valve=\"%d\"", v);
+    out.sample("garden_watering_volume_ml_total", labels, (uint64_t)stats.wateredMl[v]);
+  }
+  out.family("garden_pump_run_seconds_total", "counter", "Pump run time, priming included");
+  out.sample("garden_pump_run_seconds_total", nullptr, stats.pumpMs / 1e3);
+}
+
+static void sensorMetrics(MetricsWriter &out, size_t)
+{
+  SensorStats stats = sensors.getStats();
+  out.counter("garden_sensor_skipped_total", "Sensor reads skipped because the pump was active", stats.skipped);
+  out.family("garden_sensor_acquisition_seconds", "histogram", "Time to power, settle and sample the requested sensors");
+  char labels[16];
+  uint64_t cumulative = 0;
+  for (size_t b = 0; b <= SENSOR_DURATION_BUCKETS; b++)
+  {
+    cumulative += stats.buckets[b];
+    if (b < SENSOR_DURATION_BUCKETS)
+      snprintf(labels, sizeof(labels), "le=\"%g\"", SensorStats::bucketBoundsMs[b] / 1e3);
+    else
+      snprintf(labels, sizeof(labels), "le=\"+Inf\"");
+    out.sample("garden_sensor_acquisition_seconds_bucket", labels, cumulative);
+  }
+  out.sample("garden_sensor_acquisition_seconds_sum", nullptr, stats.acquireUs / 1e6);
+  out.sample("garden_sensor_acquisition_seconds_count", nullptr, (uint64_t)stats.acquisitions);
+}
 
 void setupServer()
 {
+  bootNonce = esp_random();
+
+  // events endpoint - Server-Sent Events: "log" for every new log event, "pump" on pump state change
+  setupEvents();
+
+  // metrics endpoint - Prometheus text format, see Metrics.h
+  // per-route request counts and handler latency histograms, heap watermarks,
+  // handler JSON pool, log counters, mutex contention, sensor acquisition time and watering jobs
+  metrics.addSection(heapMetrics);
+  metrics.addSection(logMetrics);
+  metrics.addSection(mutexMetrics, sizeof(mutexFamilies) / sizeof(mutexFamilies[0]));
+  metrics.addSection(sensorMetrics);
+  metrics.addSection(wateringMetrics);
+  on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request)
+     {
+    std::shared_ptr<MetricsStreamer> streamer = std::make_shared<MetricsStreamer>(metrics);
+    AsyncWebServerResponse *response = request->beginChunkedResponse(MetricsStreamer::contentType(),
+        [streamer](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+        {
+          return streamer->fill(buffer, maxLen);
+        });
+    request->send(response); });
+
   // status endpoint - returns current status as JSON
+  // soilCycle holds running statistics of the current light or dark phase per sensor,
+  // soilPreviousCycle the last finished light phase with readings (see SoilStats.h);
+  // slope is the trend of the last readings in counts per hour
   // example response:
   /*
   {
@@ -36,10 +622,10 @@ void setupServer()
         339
     ],
     "soilHumidityMin": [
-        353,
-        322,
-        297,
-        339
+        341,
+        310,
+        290,
+        330
     ],
     "soilHumidityMax": [
         353,
@@ -47,6 +633,15 @@ void setupServer()
         297,
         339
     ],
+    "soilCycle": {
+        "light": true,
+        "start": 1759604400,
+        "sensors": [
+            {"count": 24, "last": 353, "min": 341, "max": 353, "mean": 347.2, "stddev": 3.1, "ewma": 351.4, "slope": 1.25},
+            ...
+        ]
+    },
+    "soilPreviousCycle": {"light": true, "start": 1759525200, "end": 1759590000, "sensors": [...]},
     "lastReadingTimestamp": "2025-10-05 16:33:41",
     "uptime": "1d 17h 1m 37s",
     "lastResetReason": "1",
@@ -56,23 +651,48 @@ void setupServer()
     "sketchSize": 895936,
     "freeSketchSpace": 6553600
 }*/
-  server.on("/status", HTTP_GET, [](AsyncWebServerRequest *request)
+  // ETag covers config, logged readings and pump state, plus uptime minute so that
+  // heap and uptime still refresh once a minute; polling in between gets 304
+  on("/status", HTTP_GET, [](AsyncWebServerRequest *request)
             {
-    JsonDocument doc;
-    doc["wifi"] = WiFi.SSID();
+    int64_t us = esp_timer_get_time();   // microseconds since boot
+    uint64_t s = us / 1000000ULL;        // convert to seconds
+
+    response_format_t format = negotiateFormat(request);
+    uint32_t firstSeq, endSeq;
+    logManager.getSeqRange(firstSeq, endSeq);
+    char etag[56];
+    ConfigRef cfg = config.get();
+    snprintf(etag, sizeof(etag), "\"s%x-%x-%x-%d-%x-%d\"", (unsigned)bootNonce, (unsigned)cfg->version, (unsigned)endSeq, pumpActive ? 1 : 0, (unsigned)(s / 60), format);
+    if (sendIfNotModified(request, etag))
+      return;
+
+    const StaticStatus &fixed = getStaticStatus();
+    JsonArena arena;
+    JsonDocument doc(&arena);
+    doc["wifi"] = fixed.wifi;
     doc["ip"]   = WiFi.localIP().toString();
-    doc["mode"] = config.mode;
-    doc["lightStart"] = config.lightStart;
-    doc["lightEnd"]   = config.lightEnd;
-    doc["sensorSettleTime"] = config.sensorSettleTime;
-    doc["soilLogIntervalMin"] = config.soilLogIntervalMin;
+    doc["mode"] = cfg->mode;
+    doc["lightStart"] = cfg->lightStart;
+    doc["lightEnd"]   = cfg->lightEnd;
+    doc["sensorSettleTime"] = cfg->sensorSettleTime;
+    doc["soilLogIntervalMin"] = cfg->soilLogIntervalMin;
 
     JsonArray soilLast = doc["soilHumidityLast"].to<JsonArray>();
     for (int i = 0; i < 4; i++) soilLast.add(soilReadingsLast[i]);
+    // min/max of the running light or dark phase, the previous one for sensors without readings yet
+    SoilCycle current, previous;
+    bool hasPrevious = soilStats.snapshot(hal::now(), cfg->lightStart, cfg->lightEnd, current, previous);
     JsonArray soilMax = doc["soilHumidityMax"].to<JsonArray>();
-    for (int i = 0; i < 4; i++) soilMax.add(soilReadingsMax[i]);
     JsonArray soilMin = doc["soilHumidityMin"].to<JsonArray>();
-    for (int i = 0; i < 4; i++) soilMin.add(soilReadingsMin[i]);
+    for (int i = 0; i < 4; i++) {
+      const SoilSummary &s = current.sensors[i].count ? current.sensors[i] : previous.sensors[i];
+      soilMax.add(s.max);
+      soilMin.add(s.min);
+    }
+    addSoilCycle(doc["soilCycle"].to<JsonObject>(), current);
+    if (hasPrevious)
+      addSoilCycle(doc["soilPreviousCycle"].to<JsonObject>(), previous);
 
     time_t now = time(nullptr);
     struct tm timeinfo;
@@ -80,24 +700,22 @@ void setupServer()
     char buf[25];
     strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
     doc["lastReadingTimestamp"] = buf;
-    int64_t us = esp_timer_get_time();   // microseconds since boot
-    uint64_t s = us / 1000000ULL;        // convert to seconds
 
     uint32_t days    = s / 86400;
     uint32_t hours   = (s % 86400) / 3600;
     uint32_t minutes = (s % 3600) / 60;
     uint32_t seconds = s % 60;
-    doc["uptime"] = String(days) + "d " + String(hours) + "h " + String(minutes) + "m " + String(seconds) + "s";
-    doc["lastResetReason"] = String(esp_reset_reason());
+    char uptime[32];
+    snprintf(uptime, sizeof(uptime), "%ud %uh %um %us", (unsigned)days, (unsigned)hours, (unsigned)minutes, (unsigned)seconds);
+    doc["uptime"] = uptime;
+    doc["lastResetReason"] = fixed.lastResetReason;
     doc["pumpActive"] = pumpActive;
     doc["freeHeap"] = ESP.getFreeHeap();
-    doc["flashChipSize"] = ESP.getFlashChipSize();
-    doc["sketchSize"] = ESP.getSketchSize();
-    doc["freeSketchSpace"] = ESP.getFreeSketchSpace();
+    doc["flashChipSize"] = fixed.flashChipSize;
+    doc["sketchSize"] = fixed.sketchSize;
+    doc["freeSketchSpace"] = fixed.freeSketchSpace;
 
-    String json;
-    serializeJson(doc, json);
-    request->send(200, "application/json", json); });
+    sendDocument(request, doc, format, etag); });
 
   // config endpoint - GET returns current config as JSON
   // POST with JSON body to update config (and optionally save to flash)
@@ -140,44 +758,42 @@ void setupServer()
   ]
 }
 */
-  server.on("/config", HTTP_GET, [](AsyncWebServerRequest *request)
+  // served from cache, rebuilt only when config changes; honors If-None-Match
+  on("/config", HTTP_GET, [](AsyncWebServerRequest *request)
             {
-        JsonDocument outDoc;
-        outDoc["mode"] = config.mode;
-        outDoc["lightStart"] = config.lightStart;
-        outDoc["lightEnd"] = config.lightEnd;
-        outDoc["sensorSettleTime"] = config.sensorSettleTime;
-        outDoc["soilLogIntervalMin"] = config.soilLogIntervalMin;
-        outDoc["soilSensorCounter"] = config.soilSensorCounter;
-
-        JsonArray arr = outDoc["wateringSchedules"].to<JsonArray>();
-        for (auto &ws : config.wateringSchedules) {
-            JsonObject obj = arr.add<JsonObject>();
-            obj["time"] = ws.time;
-            JsonArray d = obj["durations"].to<JsonArray>();
-            for (int v = 0; v < 4; v++) d.add(ws.durations[v]);
-        }
-
-        String json;
-        serializeJson(outDoc, json);
-        request->send(200, "application/json", json); });
+        String etag = getConfigETag();
+        if (sendIfNotModified(request, etag))
+          return;
+        sendWithETag(request, getConfigJson(), etag); });
 
-  server.on("/config", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+  on("/config", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
             {
-        JsonDocument doc;
+        JsonArena arena;
+        JsonDocument doc(&arena);
         DeserializationError err = deserializeJson(doc, data, len);
         if (err) {
             request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
             return;
         }
 
-        // --- Apply basic fields ---
-        if (doc["mode"].is<const char*>()) config.mode = String(doc["mode"].as<const char*>());
-        if (doc["lightStart"].is<int>()) config.lightStart = doc["lightStart"].as<int>();
-        if (doc["lightEnd"].is<int>()) config.lightEnd = doc["lightEnd"].as<int>();
-        if (doc["sensorSettleTime"].is<int>()) config.sensorSettleTime = doc["sensorSettleTime"].as<int>();
-        if (doc["soilLogIntervalMin"].is<int>()) config.soilLogIntervalMin = doc["soilLogIntervalMin"].as<int>();
-        if (doc["soilSensorCounter"].is<int>()) config.soilSensorCounter = doc["soilSensorCounter"].as<int>();
+        if (doc["mode"].is<const char*>() && strlen(doc["mode"].as<const char*>()) >= CONFIG_MODE_LEN) {
+            request->send(400, "application/json", "{\"error\":\"mode too long\"}");
+            return;
+        }
+        if (doc["wateringSchedules"].is<JsonArray>() && doc["wateringSchedules"].size() > CONFIG_MAX_SCHEDULES) {
+            request->send(400, "application/json", "{\"error\":\"Too many wateringSchedules\"}");
+            return;
+        }
+
+        // --- Apply basic fields to a copy, readers keep the current snapshot meanwhile ---
+        ConfigData next = *config.get();
+        if (doc["mode"].is<const char*>()) next.mode = doc["mode"].as<const char*>();
+        if (doc["lightStart"].is<int>()) next.lightStart = doc["lightStart"].as<int>();
+        if (doc["lightEnd"].is<int>()) next.lightEnd = doc["lightEnd"].as<int>();
+        if (doc["sensorSettleTime"].is<int>()) next.sensorSettleTime = doc["sensorSettleTime"].as<int>();
+        if (doc["soilLogIntervalMin"].is<int>()) next.soilLogIntervalMin = doc["soilLogIntervalMin"].as<int>();
+        if (doc["soilSensorCounter"].is<int>()) next.soilSensorCounter = doc["soilSensorCounter"].as<int>();
+        if (doc["sensorGroupSize"].is<int>()) next.sensorGroupSize = constrain(doc["sensorGroupSize"].as<int>(), 1, 4);
 
         // --- Validate and apply watering schedules ---
         if (doc["wateringSchedules"].is<JsonArray>()) {
@@ -206,7 +822,7 @@ void setupServer()
               }
 
               WateringSchedule ws;
-              ws.time = t;
+              ws.time = t.c_str();
               for (int i = 0; i < 4; i++)
               {
                 int d = arr[i].as<int>();
@@ -221,114 +837,318 @@ void setupServer()
             }
 
             // Replace only if all schedules valid
-            config.wateringSchedules = newSchedules;
+            next.wateringSchedules = newSchedules;
         }
 
+        config.publish(next);
+        scheduler.reload();
+
         // Save if requested
         if (doc["save"].is<bool>() && doc["save"].as<bool>()) {
             config.save();
         }
 
         // --- Respond with full updated config (same as GET) ---
-        JsonDocument outDoc;
-        outDoc["mode"] = config.mode;
-        outDoc["lightStart"] = config.lightStart;
-        outDoc["lightEnd"] = config.lightEnd;
-        outDoc["sensorSettleTime"] = config.sensorSettleTime;
-        outDoc["soilLogIntervalMin"] = config.soilLogIntervalMin;
-        outDoc["soilSensorCounter"] = config.soilSensorCounter;
-
-        JsonArray arr = outDoc["wateringSchedules"].to<JsonArray>();
-        for (auto &ws : config.wateringSchedules) {
-            JsonObject obj = arr.add<JsonObject>();
-            obj["time"] = ws.time;
-            JsonArray d = obj["durations"].to<JsonArray>();
-            for (int v = 0; v < 4; v++) d.add(ws.durations[v]);
-        }
-
-        String json;
-        serializeJson(outDoc, json);
-        request->send(200, "application/json", json); });
+        sendWithETag(request, getConfigJson(), getConfigETag()); });
   // reset endpoint - resets config to defaults
   // require to recover from BAD or create NEW config on config structure change
-  server.on("/reset", HTTP_POST, [](AsyncWebServerRequest *request)
+  on("/reset", HTTP_POST, [](AsyncWebServerRequest *request)
             {
     config.reset();
+    scheduler.reload();
     request->send(200, "application/json", "{\"status\":\"reset\"}"); });
 
-  server.on("/logs", HTTP_GET, [](AsyncWebServerRequest *request)
+  // logs endpoint - streams the event log as a chunked JSON array
+  // (or CSV / columnar MessagePack by Accept header, see LogStreamer.h)
+  // events are rendered straight into the TCP send buffer, so peak memory
+  // does not depend on log size
+  // optional filters: from, to (epoch or 'YYYY-MM-DD HH:MM:SS'), type (e.g. SOIL_READING_1,WATERING_*),
+  // offset, limit
+  // example: /logs?from=2025-10-05%2014:00&type=SOIL_READING_1
+  on("/logs", HTTP_GET, [](AsyncWebServerRequest *request)
             {
-    JsonDocument doc;
-    JsonArray arr = doc.to<JsonArray>();
-  int count = logManager.getEventCount();
-    for (int i = 0; i < count; i++) {
-  Event event = logManager.getEvent(i);
-      JsonObject obj = arr.add<JsonObject>();
-      // Format timestamp as 'YYYY-MM-DD HH:MM:SS'
-      char buf[25];
-      time_t t = event.timestamp;
-      struct tm timeinfo;
-      localtime_r(&t, &timeinfo);
-      strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
-      obj["timestamp"] = buf;
-      obj["timestamp"] = buf;
-      obj["eventType"] = logManager.getEventTypeName(event.eventType);
-      obj["value"] = event.value;
+    LogQuery query;
+    const char *error = parseLogQuery(request, query);
+    if (error) {
+      request->send(400, "application/json", String("{\"error\":\"") + error + "\"}");
+      return;
     }
-    String json;
-    serializeJson(doc, json);
-    request->send(200, "application/json", json); });
+    response_format_t format = negotiateFormat(request);
+    std::shared_ptr<LogStreamer> streamer = std::make_shared<LogStreamer>(logManager, query, format);
+    AsyncWebServerResponse *response = request->beginChunkedResponse(LogStreamer::contentType(format),
+        [streamer](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+        {
+          return streamer->fill(buffer, maxLen);
+        });
+    response->addHeader("Vary", "Accept");
+    request->send(response); });
 
-  // sensors endpoint - mannualy reads soil sensors and returns current readings as JSON
-  server.on("/sensors", HTTP_GET, [](AsyncWebServerRequest *request)
+  // archive endpoint - one file of soil readings per past day (see SoilArchive.h)
+  // without parameters lists the files newest first, ?date=YYYY-MM-DD or ?file=NAME
+  // streams that day as {"date","start","sensors":[{"sensor","count","min","max","readings":[[epoch,value],...]}]}
+  // decoded from the file while sending, a day never sits in RAM
+  // must be registered before /sensors, which would match /sensors/* as well
+  on("/sensors/archive", HTTP_GET, [](AsyncWebServerRequest *request)
             {
-    readSoilSensors();
-    JsonDocument doc;
+    const char *key = request->hasParam("date") ? "date" : request->hasParam("file") ? "file" : nullptr;
+    if (!key) {
+      std::vector<std::string> names = archive.list();
+      JsonArena arena;
+      JsonDocument doc(&arena);
+      JsonArray files = doc.to<JsonArray>();
+      for (const std::string &name : names)
+        files.add(name.c_str());
+      sendDocument(request, doc, FORMAT_JSON);
+      return;
+    }
+
+    char path[48];
+    if (!SoilArchive::pathFor(request->getParam(key)->value().c_str(), path, sizeof(path))) {
+      request->send(400, "application/json", "{\"error\":\"Expected YYYY-MM-DD or a listed file name\"}");
+      return;
+    }
+    std::shared_ptr<ArchiveStreamer> streamer = std::make_shared<ArchiveStreamer>();
+    if (!streamer->open(path)) {
+      request->send(404, "application/json", "{\"error\":\"No archive for this day\"}");
+      return;
+    }
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+        [streamer](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+        {
+          return streamer->fill(buffer, maxLen);
+        });
+    // past days do not change
+    response->addHeader("Cache-Control", "max-age=86400");
+    request->send(response); });
+
+  // rollup endpoint - hourly or daily soil aggregates per sensor, oldest first
+  // must be registered before /sensors, which would match /sensors/* as well
+  // example: /sensors/rollup?tier=day&sensor=1
+  // buckets are [start epoch, min, max, avg, count]
+  on("/sensors/rollup", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    rollup_tier_t tier = ROLLUP_HOUR;
+    if (request->hasParam("tier")) {
+      String t = request->getParam("tier")->value();
+      if (t == "day") tier = ROLLUP_DAY;
+      else if (t != "hour") {
+        request->send(400, "application/json", "{\"error\":\"tier must be hour or day\"}");
+        return;
+      }
+    }
+    int first = 0, last = ROLLUP_SENSORS - 1;
+    if (request->hasParam("sensor")) {
+      first = last = request->getParam("sensor")->value().toInt();
+      if (first < 0 || first >= ROLLUP_SENSORS) {
+        request->send(400, "application/json", "{\"error\":\"sensor out of range\"}");
+        return;
+      }
+    }
+
+    JsonArena arena;
+    JsonDocument doc(&arena);
+    doc["tier"] = tier == ROLLUP_DAY ? "day" : "hour";
+    doc["period"] = SoilRollup::period(tier);
+    JsonArray sensors = doc["sensors"].to<JsonArray>();
+    // handlers all run on the async_tcp task, a static buffer keeps ~1 KB off its stack
+    static RollupBucket buckets[ROLLUP_DAYS > ROLLUP_HOURS ? ROLLUP_DAYS : ROLLUP_HOURS];
+    for (int s = first; s <= last; s++) {
+      JsonObject obj = sensors.add<JsonObject>();
+      obj["sensor"] = s;
+      JsonArray arr = obj["buckets"].to<JsonArray>();
+      size_t n = logManager.getRollup(s, tier, buckets, SoilRollup::capacity(tier));
+      for (size_t i = 0; i < n; i++) {
+        const RollupBucket &b = buckets[i];
+        JsonArray row = arr.add<JsonArray>();
+        row.add(b.start);
+        row.add(b.min);
+        row.add(b.max);
+        row.add((b.sum + b.count / 2) / b.count);
+        row.add(b.count);
+      }
+    }
+    sendDocument(request, doc, FORMAT_JSON); });
+
+  // sensors endpoint - mannualy reads soil sensors
+  // reading takes seconds, so it runs on the acquisition task and this returns at once:
+  // GET /sensors starts a sweep (or joins the one in progress) and answers 202 with a job ID,
+  // GET /sensors?job=ID answers 202 while pending, then 200 with current readings,
+  // or 200 with status "skipped" and no readings if the pump was running
+  on("/sensors", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    uint32_t job;
+    if (request->hasParam("job")) {
+      job = strtoul(request->getParam("job")->value().c_str(), nullptr, 10);
+    } else {
+      job = sensors.requestSweep();
+      if (!job) {
+        request->send(503, "application/json", "{\"error\":\"Sensor queue full\"}");
+        return;
+      }
+    }
+
+    sensor_job_state_t state = sensors.getJobState(job);
+    if (state == SENSOR_JOB_UNKNOWN) {
+      request->send(404, "application/json", "{\"error\":\"Unknown job\"}");
+      return;
+    }
+
+    JsonArena arena;
+    JsonDocument doc(&arena);
+    doc["job"] = job;
+    if (state == SENSOR_JOB_PENDING) {
+      doc["status"] = "pending";
+      AsyncWebServerResponse *response = new PooledResponse(202, doc, FORMAT_JSON);
+      response->addHeader("Location", "/sensors?job=" + String(job));
+      request->send(response);
+      return;
+    }
+    if (state == SENSOR_JOB_SKIPPED) {
+      // pump was running, soilReadingsLast would be stale
+      doc["status"] = "skipped";
+      doc["reason"] = "pumpActive";
+      sendDocument(request, doc, FORMAT_JSON);
+      return;
+    }
+    doc["status"] = "done";
     JsonArray soil = doc["soilReadingsLast"].to<JsonArray>();
     for (int i = 0; i < 4; i++) soil.add(soilReadingsLast[i]);
-    String json;
-    serializeJson(doc, json);
-    request->send(200, "application/json", json); });
-
-  // watering endpoint - starts watering cycle with optional durations for each valve
-  // example: /watering?duration0=30&duration1=45&duration2=0&duration3=15
-  // durations in seconds, if not specified valve will be skipped
-  // if pump already active, returns 409 error
-  server.on("/watering", HTTP_POST, [](AsyncWebServerRequest *request)
+    sendDocument(request, doc, negotiateFormat(request)); });
+
+  // watering endpoint - queues a watering job with a volume or a duration for each valve
+  // example: /watering?volume0=450&volume1=450&volume3=300 or /watering?duration0=30&duration1=45
+  // volumes in ml (0-10000), durations in seconds (0-600) are turned into the volume
+  // they deliver at the calibrated flow rate; valves not specified are skipped
+  // jobs run one after another on the watering task, answers 202 with a job ID and
+  // the planned open time per valve, 503 if the queue is full
+  on("/watering", HTTP_POST, [](AsyncWebServerRequest *request)
             {
+    int durations[WATERING_VALVES] = {0};
+    int volumes[WATERING_VALVES] = {0};
+    bool byDuration = false, byVolume = false;
+    for (int i = 0; i < WATERING_VALVES; i++) {
+      char name[12];
+      snprintf(name, sizeof(name), "duration%d", i);
+      if (request->hasParam(name)) {
+        byDuration = true;
+        durations[i] = request->getParam(name)->value().toInt();
+        if (durations[i] < 0 || durations[i] > 600) {
+          request->send(400, "application/json", "{\"error\":\"Durations must be 0-600 seconds\"}");
+          return;
+        }
+      }
+      snprintf(name, sizeof(name), "volume%d", i);
+      if (request->hasParam(name)) {
+        byVolume = true;
+        volumes[i] = request->getParam(name)->value().toInt();
+        if (volumes[i] < 0 || volumes[i] > WATERING_MAX_VOLUME_ML) {
+          request->send(400, "application/json", "{\"error\":\"Volumes must be 0-10000 ml\"}");
+          return;
+        }
+      }
+    }
+    if (byDuration && byVolume) {
+      request->send(400, "application/json", "{\"error\":\"Give either durations or volumes\"}");
+      return;
+    }
+    if (byDuration)
+      watering.volumesFor(durations, volumes);
 
-    if (pumpActive) {
-      request->send(409, "application/json", "{\"error\":\"Pump already active\"}");
+    WateringPlan plan;
+    uint32_t job = watering.enqueue(volumes, WATERING_SOURCE_MANUAL, &plan);
+    if (!job) {
+      if (plan.totalMs)
+        request->send(503, "application/json", "{\"error\":\"Watering queue full\"}");
+      else
+        request->send(400, "application/json", "{\"error\":\"No valve durations or volumes given\"}");
       return;
     }
 
-    int duration0 = 0;
-    if (request->hasParam("duration0")) {
-      duration0 = request->getParam("duration0")->value().toInt();
+    JsonArena arena;
+    JsonDocument doc(&arena);
+    doc["job"] = job;
+    for (int i = 0; i < WATERING_VALVES; i++) {
+      char name[12];
+      snprintf(name, sizeof(name), "volume%d", i);
+      doc[name] = plan.volumeMl[i];
+      snprintf(name, sizeof(name), "duration%d", i);
+      doc[name] = (plan.durationMs[i] + 500) / 1000;
     }
-    int duration1 = 0;
-    if (request->hasParam("duration1")) {
-      duration1 = request->getParam("duration1")->value().toInt();
+    doc["total"] = (plan.totalMs + 999) / 1000;
+    doc["status"] = "queued";
+    doc["queued"] = watering.getStatus().queued;
+    AsyncWebServerResponse *response = new PooledResponse(202, doc, FORMAT_JSON);
+    response->addHeader("Location", "/watering?job=" + String(job));
+    request->send(response); });
+
+  // watering status - queue depth and progress of the running job,
+  // or with ?job=ID the state of one job (404 when unknown or too old)
+  on("/watering", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    WateringStatus status = watering.getStatus();
+    JsonArena arena;
+    JsonDocument doc(&arena);
+    if (request->hasParam("job")) {
+      uint32_t job = strtoul(request->getParam("job")->value().c_str(), nullptr, 10);
+      watering_job_state_t state = watering.getJobState(job);
+      if (state == WATERING_JOB_UNKNOWN) {
+        request->send(404, "application/json", "{\"error\":\"Unknown job\"}");
+        return;
+      }
+      doc["job"] = job;
+      doc["status"] = wateringJobStateName(state);
+      if (state != WATERING_JOB_RUNNING || status.runningJob != job) {
+        sendDocument(request, doc, negotiateFormat(request));
+        return;
+      }
+    } else {
+      doc["queued"] = status.queued;
+      doc["pumpActive"] = pumpActive;
+      doc["job"] = status.runningJob;
+      if (!status.runningJob) {
+        sendDocument(request, doc, negotiateFormat(request));
+        return;
+      }
     }
-    int duration2 = 0;
-    if (request->hasParam("duration2")) {
-      duration2 = request->getParam("duration2")->value().toInt();
+    doc["source"] = status.source == WATERING_SOURCE_SCHEDULE ? "schedule" : "manual";
+    doc["valve"] = status.valve;
+    JsonArray open = doc["valves"].to<JsonArray>();
+    for (int i = 0; i < WATERING_VALVES; i++)
+      if (status.valveMask & (1 << i))
+        open.add(i);
+    doc["elapsed"] = status.elapsedSec;
+    doc["total"] = status.totalSec;
+    sendDocument(request, doc, negotiateFormat(request)); });
+
+  // cancels a queued or running watering job (?job=ID), or everything without job
+  // a running job closes its valve at once
+  on("/watering", HTTP_DELETE, [](AsyncWebServerRequest *request)
+            {
+    if (!request->hasParam("job")) {
+      size_t n = watering.cancelAll();
+      request->send(200, "application/json", "{\"cancelled\":" + String((unsigned)n) + "}");
+      return;
     }
-    int duration3 = 0;
-    if (request->hasParam("duration3")) {
-      duration3 = request->getParam("duration3")->value().toInt();
+    uint32_t job = strtoul(request->getParam("job")->value().c_str(), nullptr, 10);
+    if (watering.cancel(job)) {
+      request->send(200, "application/json", "{\"job\":" + String(job) + ",\"status\":\"cancelled\"}");
+      return;
     }
+    watering_job_state_t state = watering.getJobState(job);
+    if (state == WATERING_JOB_UNKNOWN)
+      request->send(404, "application/json", "{\"error\":\"Unknown job\"}");
+    else
+      request->send(409, "application/json", String("{\"error\":\"Job already ") + wateringJobStateName(state) + "\"}"); });
 
-    wateringCycle(duration0, duration1, duration2, duration3);
-    JsonDocument doc;
-    doc["duration0"] = duration0;
-    doc["duration1"] = duration1;
-    doc["duration2"] = duration2;
-    doc["duration3"] = duration3;
-    doc["status"] = "started";
-    String json;
-    serializeJson(doc, json);
-    request->send(200, "application/json", json); });
-
-  server.begin();
+  // dashboard - built from web/ into data/www/ by scripts/build_web.py (pio run -t uploadfs)
+  // files are stored as .gz only and sent with Content-Encoding: gzip
+  // assets carry a content hash in their name and never change, so browsers keep them
+  // for a year without asking; index.html is revalidated on every load (304 via ETag)
+  // registered last: the static handlers only answer for files that exist, but API
+  // routes should not pay for a LittleFS lookup first
+  server.serveStatic("/assets/", LittleFS, "/www/assets/")
+      .setCacheControl("public, max-age=31536000, immutable");
+  server.serveStatic("/", LittleFS, "/www/")
+      .setDefaultFile("index.html")
+      .setCacheControl("no-cache");
 }
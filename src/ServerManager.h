@@ -7,5 +7,8 @@
 extern AsyncWebServer server;
 
 
-// Setup all REST endpoints
-void setupServer();
\ No newline at end of file
+// Setup all REST endpoints, the caller starts the server once its tasks run
+void setupServer();
+
+// Pushes pump state change to /events subscribers
+void publishPumpState(bool active);
\ No newline at end of file
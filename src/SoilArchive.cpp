@@ -0,0 +1,453 @@
+#include "SoilArchive.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "Crc32.h"
+
+#define ARCHIVE_EPOCH_MIN 1577836800 // 2020-01-01, earlier clocks are not NTP synced
+#define ARCHIVE_BATCH 16             // events per log read
+
+static size_t putVarint(uint8_t *out, uint32_t v)
+{
+  size_t n = 0;
+  while (v >= 0x80)
+  {
+    out[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  out[n++] = (uint8_t)v;
+  return n;
+}
+
+static inline uint32_t zigzag(int32_t v)
+{
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Local midnight at or before t
+static time_t dayStartOf(time_t t)
+{
+  struct tm timeinfo;
+  localtime_r(&t, &timeinfo);
+  timeinfo.tm_hour = timeinfo.tm_min = timeinfo.tm_sec = 0;
+  timeinfo.tm_isdst = -1;
+  return mktime(&timeinfo);
+}
+
+// Local midnight after day, 23 or 25 hours later on DST changes
+static time_t nextDay(time_t day)
+{
+  struct tm timeinfo;
+  localtime_r(&day, &timeinfo);
+  timeinfo.tm_mday++;
+  timeinfo.tm_hour = timeinfo.tm_min = timeinfo.tm_sec = 0;
+  timeinfo.tm_isdst = -1;
+  return mktime(&timeinfo);
+}
+
+static void fileName(time_t day, char *name, size_t len)
+{
+  struct tm timeinfo;
+  localtime_r(&day, &timeinfo);
+  snprintf(name, len, "soil_%04u-%02u-%02u.bin", (unsigned)(timeinfo.tm_year + 1900) % 10000u,
+           (unsigned)(timeinfo.tm_mon + 1) % 100u, (unsigned)timeinfo.tm_mday % 100u);
+}
+
+static bool isDate(const char *s)
+{
+  for (int i = 0; i < 10; i++)
+  {
+    bool ok = (i == 4 || i == 7) ? s[i] == '-' : (s[i] >= '0' && s[i] <= '9');
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+static bool isArchiveName(const char *name)
+{
+  return strlen(name) == ARCHIVE_NAME_LEN - 1 && strncmp(name, "soil_", 5) == 0 && isDate(name + 5) &&
+         strcmp(name + 15, ".bin") == 0;
+}
+
+// Calls fn(sensor, time, value) for every soil reading in [dayStart, dayEnd), log order
+template <typename Fn>
+static void forEachReading(const LogManager &logs, time_t dayStart, time_t dayEnd, Fn fn)
+{
+  Event batch[ARCHIVE_BATCH];
+  uint32_t cursor = logs.seekTime(dayStart);
+  for (;;)
+  {
+    size_t n = logs.readEvents(cursor, batch, ARCHIVE_BATCH);
+    if (!n)
+      return;
+    for (size_t i = 0; i < n; i++)
+    {
+      const Event &e = batch[i];
+      if (e.timestamp >= dayEnd)
+        return;
+      if (e.timestamp >= dayStart && e.eventType >= EVENT_SOIL_READINGS_0 && e.eventType <= EVENT_SOIL_READINGS_3)
+        fn(e.eventType - EVENT_SOIL_READINGS_0, (uint32_t)e.timestamp, e.value);
+    }
+  }
+}
+
+// ===============================================================
+// SoilArchive
+// ===============================================================
+
+SoilArchive::SoilArchive() : lastDay(0)
+{
+}
+
+bool SoilArchive::begin()
+{
+  if (!hal::fsExists(ARCHIVE_DIR) && !hal::fsMkdir(ARCHIVE_DIR))
+  {
+    hal::logf("[Archive] Cannot create %s\n", ARCHIVE_DIR);
+    return false;
+  }
+
+  // the newest file may have been cut short by a power loss, it is written again
+  std::vector<std::string> names = list();
+  size_t days = names.size();
+  for (const std::string &name : names)
+  {
+    char path[48];
+    snprintf(path, sizeof(path), "%s/%s", ARCHIVE_DIR, name.c_str());
+    ArchiveStreamer check;
+    if (check.open(path))
+    {
+      struct tm timeinfo = {};
+      sscanf(name.c_str() + 5, "%d-%d-%d", &timeinfo.tm_year, &timeinfo.tm_mon, &timeinfo.tm_mday);
+      timeinfo.tm_year -= 1900;
+      timeinfo.tm_mon -= 1;
+      timeinfo.tm_isdst = -1;
+      lastDay = mktime(&timeinfo);
+      break;
+    }
+    hal::logf("[Archive] %s is corrupt, removed\n", name.c_str());
+    hal::fsRemove(path);
+    days--;
+  }
+  hal::logf("[Archive] %u days archived\n", (unsigned)days);
+  return true;
+}
+
+std::vector<std::string> SoilArchive::list() const
+{
+  std::vector<std::string> names;
+  hal::fsList(ARCHIVE_DIR, [&names](const char *name)
+              {
+                if (isArchiveName(name))
+                  names.push_back(name); });
+  // dates in the name sort chronologically
+  std::sort(names.begin(), names.end(), [](const std::string &a, const std::string &b)
+            { return a > b; });
+  return names;
+}
+
+bool SoilArchive::pathFor(const char *dateOrName, char *path, size_t len)
+{
+  if (dateOrName[0] == '/')
+    dateOrName++;
+  const char *date = nullptr;
+  if (strlen(dateOrName) == 10 && isDate(dateOrName))
+    date = dateOrName;
+  else if (isArchiveName(dateOrName))
+    date = dateOrName + 5;
+  if (!date)
+    return false;
+  snprintf(path, len, "%s/soil_%.10s.bin", ARCHIVE_DIR, date);
+  return true;
+}
+
+void SoilArchive::rollover(const LogManager &logs, time_t now)
+{
+  time_t today = dayStartOf(now);
+  if (today < ARCHIVE_EPOCH_MIN)
+    return;
+
+  uint32_t firstSeq, endSeq;
+  logs.getSeqRange(firstSeq, endSeq);
+  Event oldest;
+  if (firstSeq == endSeq || !logs.readEvents(firstSeq, &oldest, 1))
+    return;
+
+  // days before the oldest logged event, or beyond the retention, have nothing to archive
+  time_t day = lastDay ? nextDay(lastDay) : 0;
+  time_t floor = dayStartOf(std::max(oldest.timestamp, today - (time_t)ARCHIVE_MAX_DAYS * 86400));
+  if (day < floor)
+    day = floor;
+
+  bool wrote = false;
+  for (; day < today; day = nextDay(day))
+  {
+    bool written = false;
+    if (!writeDay(logs, day, nextDay(day), written))
+      break; // retried on the next pass, while the day is still in the log
+    wrote |= written;
+    lastDay = day;
+  }
+  if (wrote)
+    prune();
+}
+
+bool SoilArchive::writeDay(const LogManager &logs, time_t dayStart, time_t dayEnd, bool &written)
+{
+  written = false;
+  uint32_t counts[ARCHIVE_SENSORS] = {0};
+  forEachReading(logs, dayStart, dayEnd, [&counts](int s, uint32_t, uint16_t)
+                 {
+                   if (counts[s] < ARCHIVE_MAX_READINGS)
+                     counts[s]++; });
+  size_t total = 0;
+  for (int s = 0; s < ARCHIVE_SENSORS; s++)
+    total += counts[s];
+  if (!total)
+    return true;
+
+  // worst case 5 bytes per time delta and 3 per value delta, each column in its own slice
+  uint8_t *data = (uint8_t *)hal::allocLarge(total * 8);
+  if (!data)
+  {
+    hal::logf("[Archive] No memory for %u readings\n", (unsigned)total);
+    return false;
+  }
+  ArchiveHeader header;
+  memset(&header, 0, sizeof(header));
+  size_t timeSlice[ARCHIVE_SENSORS], valueSlice[ARCHIVE_SENSORS];
+  uint32_t lastTime[ARCHIVE_SENSORS];
+  int32_t lastValue[ARCHIVE_SENSORS];
+  size_t slice = 0;
+  for (int s = 0; s < ARCHIVE_SENSORS; s++)
+  {
+    timeSlice[s] = slice;
+    valueSlice[s] = slice + counts[s] * 5;
+    slice += counts[s] * 8;
+    lastTime[s] = (uint32_t)dayStart;
+    lastValue[s] = 0;
+    header.index[s].min = UINT16_MAX;
+  }
+
+  forEachReading(logs, dayStart, dayEnd, [&](int s, uint32_t t, uint16_t v)
+                 {
+                   ArchiveColumn &c = header.index[s];
+                   if (c.count >= counts[s])
+                     return;
+                   c.timeBytes += putVarint(data + timeSlice[s] + c.timeBytes, zigzag((int32_t)(t - lastTime[s])));
+                   c.valueBytes += putVarint(data + valueSlice[s] + c.valueBytes, zigzag((int32_t)v - lastValue[s]));
+                   lastTime[s] = t;
+                   lastValue[s] = v;
+                   c.min = std::min(c.min, v);
+                   c.max = std::max(c.max, v);
+                   c.count++; });
+
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.columns = ARCHIVE_SENSORS;
+  header.dayStart = (uint32_t)dayStart;
+  uint32_t offset = sizeof(header);
+  for (int s = 0; s < ARCHIVE_SENSORS; s++)
+  {
+    ArchiveColumn &c = header.index[s];
+    if (!c.count)
+      c.min = 0;
+    c.offset = offset;
+    offset += c.timeBytes + c.valueBytes;
+    header.crc = crc32(data + timeSlice[s], c.timeBytes, header.crc);
+    header.crc = crc32(data + valueSlice[s], c.valueBytes, header.crc);
+  }
+
+  char name[ARCHIVE_NAME_LEN], path[48];
+  fileName(dayStart, name, sizeof(name));
+  snprintf(path, sizeof(path), "%s/%s", ARCHIVE_DIR, name);
+  hal::File file;
+  bool ok = file.open(path, "w") && file.write(&header, sizeof(header)) == sizeof(header);
+  for (int s = 0; ok && s < ARCHIVE_SENSORS; s++)
+  {
+    const ArchiveColumn &c = header.index[s];
+    ok = file.write(data + timeSlice[s], c.timeBytes) == c.timeBytes &&
+         file.write(data + valueSlice[s], c.valueBytes) == c.valueBytes;
+  }
+  file.close();
+  free(data);
+
+  if (!ok)
+  {
+    hal::logf("[Archive] Writing %s failed\n", path);
+    hal::fsRemove(path);
+    return false;
+  }
+  hal::logf("[Archive] %s: %u readings in %u bytes\n", name, (unsigned)total, (unsigned)offset);
+  written = true;
+  return true;
+}
+
+void SoilArchive::prune()
+{
+  std::vector<std::string> names = list();
+  for (size_t i = ARCHIVE_MAX_DAYS; i < names.size(); i++)
+  {
+    char path[48];
+    snprintf(path, sizeof(path), "%s/%s", ARCHIVE_DIR, names[i].c_str());
+    hal::fsRemove(path);
+  }
+}
+
+// ===============================================================
+// ArchiveStreamer
+// ===============================================================
+
+ArchiveStreamer::ArchiveStreamer()
+    : sensor(-1), inColumn(false), remaining(0), time(0), value(0), pendingLength(0), pendingOffset(0)
+{
+  memset(&header, 0, sizeof(header));
+  memset(&times, 0, sizeof(times));
+  memset(&values, 0, sizeof(values));
+}
+
+bool ArchiveStreamer::open(const char *path)
+{
+  if (!file.open(path, "r"))
+    return false;
+  size_t size = file.size();
+  if (file.read(&header, sizeof(header)) != sizeof(header) || header.magic != SoilArchive::MAGIC ||
+      header.version != SoilArchive::VERSION || header.columns != ARCHIVE_SENSORS)
+    return false;
+
+  size_t end = sizeof(header);
+  for (int s = 0; s < ARCHIVE_SENSORS; s++)
+  {
+    const ArchiveColumn &c = header.index[s];
+    if (c.offset != end)
+      return false;
+    end += c.timeBytes + c.valueBytes;
+  }
+  if (end != size)
+    return false;
+
+  // columns are stored back to back, one pass over the data
+  uint8_t buf[128];
+  uint32_t crc = 0;
+  for (size_t n; (n = file.read(buf, sizeof(buf))) > 0;)
+    crc = crc32(buf, n, crc);
+  return crc == header.crc;
+}
+
+bool ArchiveStreamer::readByte(Column &c, uint8_t &b)
+{
+  if (c.next == c.len)
+  {
+    if (c.pos >= c.end)
+      return false;
+    size_t n = std::min((size_t)(c.end - c.pos), sizeof(c.buf));
+    if (!file.seek(c.pos) || file.read(c.buf, n) != n)
+      return false;
+    c.pos += n;
+    c.len = n;
+    c.next = 0;
+  }
+  b = c.buf[c.next++];
+  return true;
+}
+
+bool ArchiveStreamer::readVarint(Column &c, uint32_t &v)
+{
+  v = 0;
+  for (int shift = 0; shift < 35; shift += 7)
+  {
+    uint8_t b;
+    if (!readByte(c, b))
+      return false;
+    v |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+void ArchiveStreamer::startColumn()
+{
+  const ArchiveColumn &c = header.index[sensor];
+  times = {};
+  times.pos = c.offset;
+  times.end = c.offset + c.timeBytes;
+  values = {};
+  values.pos = times.end;
+  values.end = times.end + c.valueBytes;
+  remaining = c.count;
+  time = header.dayStart;
+  value = 0;
+  inColumn = true;
+  pendingLength += snprintf(pending + pendingLength, sizeof(pending) - pendingLength,
+                            "%s{\"sensor\":%d,\"count\":%u,\"min\":%u,\"max\":%u,\"readings\":[",
+                            sensor ? "," : "", sensor, c.count, c.min, c.max);
+}
+
+bool ArchiveStreamer::renderNext()
+{
+  pendingLength = 0;
+  pendingOffset = 0;
+
+  if (sensor < 0)
+  {
+    time_t day = header.dayStart;
+    struct tm timeinfo;
+    localtime_r(&day, &timeinfo);
+    pendingLength = snprintf(pending, sizeof(pending), "{\"date\":\"%04d-%02d-%02d\",\"start\":%u,\"sensors\":[",
+                             timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday, (unsigned)header.dayStart);
+    sensor = 0;
+    return true;
+  }
+  if (sensor >= ARCHIVE_SENSORS)
+    return false;
+
+  if (!inColumn)
+    startColumn();
+  // a reading is at most 19 bytes, the closing brackets 4
+  while (remaining && pendingLength + 24 < sizeof(pending))
+  {
+    uint32_t dt, dv;
+    if (!readVarint(times, dt) || !readVarint(values, dv))
+    {
+      remaining = 0; // verified at open, only a failing read gets here
+      break;
+    }
+    time += unzigzag(dt);
+    value += unzigzag(dv);
+    pendingLength += snprintf(pending + pendingLength, sizeof(pending) - pendingLength, "%s[%lld,%d]",
+                              remaining != header.index[sensor].count ? "," : "",
+                              (long long)time, (int)value);
+    remaining--;
+  }
+  if (!remaining)
+  {
+    inColumn = false;
+    sensor++;
+    pendingLength += snprintf(pending + pendingLength, sizeof(pending) - pendingLength,
+                              sensor == ARCHIVE_SENSORS ? "]}]}" : "]}");
+  }
+  return true;
+}
+
+size_t ArchiveStreamer::fill(uint8_t *buffer, size_t maxLen)
+{
+  size_t written = 0;
+  while (written < maxLen)
+  {
+    if (pendingOffset == pendingLength && !renderNext())
+      break;
+    size_t n = std::min(pendingLength - pendingOffset, maxLen - written);
+    memcpy(buffer + written, pending + pendingOffset, n);
+    pendingOffset += n;
+    written += n;
+  }
+  return written;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "LogManager.h"
+#include "hal/Hal.h"
+
+// Daily soil reading archive on LittleFS, for history beyond the event log.
+//
+// Once a local day is over, its soil readings are copied from the event log
+// into /archive/soil_YYYY-MM-DD.bin and kept for ARCHIVE_MAX_DAYS days.
+// Files are columnar: a header with one index entry per sensor, then per
+// sensor a column of timestamps and a column of values. Both columns are
+// zigzag varint deltas (timestamps from the day start, values from 0), so a
+// reading every 15 minutes takes about 3 bytes. A CRC over the column data
+// rejects files cut short by a power loss; a corrupt newest file is removed
+// at boot and written again while its events are still in the log.
+//
+// ArchiveStreamer renders one file as JSON in small pieces for a chunked
+// response, reading through two small buffers, so a day of any size is never
+// loaded into RAM.
+
+#define ARCHIVE_DIR "/archive"
+#define ARCHIVE_SENSORS 4
+#define ARCHIVE_MAX_DAYS 365        // files kept, LittleFS uses at least one 4 KB block per file
+#define ARCHIVE_MAX_READINGS 8192   // per sensor and day, more are dropped
+#define ARCHIVE_NAME_LEN 20         // "soil_YYYY-MM-DD.bin" plus terminator
+
+struct ArchiveColumn {
+    uint32_t offset;     // from file start, time deltas then value deltas
+    uint16_t count;
+    uint16_t timeBytes;
+    uint16_t valueBytes;
+    uint16_t min;
+    uint16_t max;
+    uint16_t reserved;
+};
+
+struct ArchiveHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t columns;    // ARCHIVE_SENSORS
+    uint32_t dayStart;   // local midnight, epoch seconds
+    uint32_t crc;        // crc32 of everything after the header
+    ArchiveColumn index[ARCHIVE_SENSORS];
+};
+
+class SoilArchive {
+public:
+    SoilArchive();
+
+    // Creates the directory and finds the newest archived day
+    bool begin();
+    // Archives every finished day since the last one that still has events in
+    // the log, then drops files beyond ARCHIVE_MAX_DAYS. A day that fails to
+    // write stops the pass and is tried again next time. May block on flash,
+    // call periodically from a task (the scheduler).
+    void rollover(const LogManager &logs, time_t now);
+
+    // File names, newest first
+    std::vector<std::string> list() const;
+    // Path of a day's file from "YYYY-MM-DD" or a listed file name, false if malformed
+    static bool pathFor(const char *dateOrName, char *path, size_t len);
+
+    static constexpr uint32_t MAGIC = 0x43524153; // "SARC"
+    static constexpr uint16_t VERSION = 1;
+
+private:
+    // false if the day has readings but could not be written, written tells whether a file was made
+    bool writeDay(const LogManager &logs, time_t dayStart, time_t dayEnd, bool &written);
+    void prune();
+
+    time_t lastDay; // start of the newest archived (or empty) day, 0 if none
+};
+
+class ArchiveStreamer {
+public:
+    ArchiveStreamer();
+
+    // Reads the header and checks the CRC, false if missing or corrupt
+    bool open(const char *path);
+    // AsyncWebServer chunk filler: writes up to maxLen bytes, returns 0 when done
+    size_t fill(uint8_t *buffer, size_t maxLen);
+
+private:
+    // Forward reader of one column, refills by seeking
+    struct Column {
+        uint32_t pos;
+        uint32_t end;
+        uint8_t buf[64];
+        uint8_t len;
+        uint8_t next;
+    };
+
+    bool readByte(Column &c, uint8_t &b);
+    bool readVarint(Column &c, uint32_t &v);
+    void startColumn();
+    bool renderNext(); // false when finished
+
+    hal::File file;
+    ArchiveHeader header;
+    int sensor;          // column being rendered, -1 before the opening
+    bool inColumn;       // column opening rendered, readings follow
+    uint32_t remaining;  // readings left in the column
+    int64_t time;        // running sums of the deltas
+    int32_t value;
+    Column times;
+    Column values;
+    char pending[512];
+    size_t pendingLength;
+    size_t pendingOffset;
+};
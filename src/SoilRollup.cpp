@@ -0,0 +1,122 @@
+#include "SoilRollup.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include "hal/Hal.h"
+
+SoilRollup::SoilRollup() : storage(nullptr)
+{
+  memset(tiers, 0, sizeof(tiers));
+}
+
+SoilRollup::~SoilRollup()
+{
+  free(storage);
+}
+
+bool SoilRollup::begin()
+{
+  if (storage)
+    return true;
+  size_t bytes = ROLLUP_SENSORS * (ROLLUP_HOURS + ROLLUP_DAYS) * sizeof(RollupBucket);
+  storage = (RollupBucket *)hal::allocLarge(bytes);
+  if (!storage)
+    return false;
+
+  RollupBucket *p = storage;
+  for (int s = 0; s < ROLLUP_SENSORS; s++)
+  {
+    for (int t = 0; t < ROLLUP_TIER_COUNT; t++)
+    {
+      tiers[s][t].buckets = p;
+      p += capacity((rollup_tier_t)t);
+    }
+  }
+  clear();
+  return true;
+}
+
+void SoilRollup::clear()
+{
+  for (int s = 0; s < ROLLUP_SENSORS; s++)
+  {
+    for (int t = 0; t < ROLLUP_TIER_COUNT; t++)
+    {
+      tiers[s][t].head = 0;
+      tiers[s][t].count = 0;
+    }
+  }
+}
+
+uint32_t SoilRollup::bucketStart(rollup_tier_t tier, uint32_t time)
+{
+  if (tier == ROLLUP_DAY)
+  {
+    // align days to local midnight so they match the light cycle calendar
+    time_t t = time;
+    struct tm timeinfo;
+    localtime_r(&t, &timeinfo);
+    return time - (timeinfo.tm_hour * 3600 + timeinfo.tm_min * 60 + timeinfo.tm_sec);
+  }
+  return time - time % period(tier);
+}
+
+void SoilRollup::addTo(Tier &t, rollup_tier_t tier, uint32_t time, uint16_t value)
+{
+  uint32_t start = bucketStart(tier, time);
+  size_t cap = capacity(tier);
+
+  // newest bucket is the usual hit, older ones only if the clock stepped back
+  RollupBucket *b = nullptr;
+  for (size_t i = 0; i < t.count; i++)
+  {
+    RollupBucket &candidate = t.buckets[(t.head + cap - 1 - i) % cap];
+    if (candidate.start == start)
+    {
+      b = &candidate;
+      break;
+    }
+    if (candidate.start < start)
+      break;
+  }
+  if (!b)
+  {
+    if (t.count && start < t.buckets[(t.head + cap - 1) % cap].start)
+      return; // older than newest bucket and its bucket is gone, drop
+    b = &t.buckets[t.head];
+    t.head = (t.head + 1) % cap;
+    if (t.count < cap)
+      t.count++;
+    b->start = start;
+    b->sum = 0;
+    b->min = UINT16_MAX;
+    b->max = 0;
+    b->count = 0;
+  }
+  b->sum += value;
+  b->min = std::min(b->min, value);
+  b->max = std::max(b->max, value);
+  b->count++;
+}
+
+void SoilRollup::add(uint8_t sensorId, uint32_t time, uint16_t value)
+{
+  if (!storage || sensorId >= ROLLUP_SENSORS)
+    return;
+  for (int t = 0; t < ROLLUP_TIER_COUNT; t++)
+    addTo(tiers[sensorId][t], (rollup_tier_t)t, time, value);
+}
+
+size_t SoilRollup::read(uint8_t sensorId, rollup_tier_t tier, RollupBucket *out, size_t maxCount) const
+{
+  if (!storage || sensorId >= ROLLUP_SENSORS || tier >= ROLLUP_TIER_COUNT)
+    return 0;
+  const Tier &t = tiers[sensorId][tier];
+  size_t cap = capacity(tier);
+  size_t n = std::min(t.count, maxCount);
+  // newest n buckets, oldest first
+  for (size_t i = 0; i < n; i++)
+    out[i] = t.buckets[(t.head + cap - n + i) % cap];
+  return n;
+}
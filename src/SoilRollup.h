@@ -0,0 +1,58 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-sensor min/max/avg aggregates of soil readings in hourly and daily buckets.
+// Each tier is a ring of buckets, updated in O(1) per reading, so long range
+// charts do not need raw events (which are evicted much sooner).
+// Not thread safe, LogManager serializes access.
+
+#define ROLLUP_SENSORS 4
+#define ROLLUP_HOURS 48 // two days of hourly buckets
+#define ROLLUP_DAYS 62  // two months of daily buckets
+
+typedef enum
+{
+  ROLLUP_HOUR,
+  ROLLUP_DAY,
+  ROLLUP_TIER_COUNT
+} rollup_tier_t;
+
+struct RollupBucket
+{
+  uint32_t start; //!< bucket start, epoch seconds (daily buckets start at local midnight)
+  uint32_t sum;   //!< sum of readings, avg = sum / count
+  uint16_t min;
+  uint16_t max;
+  uint16_t count;
+};
+
+class SoilRollup {
+public:
+    SoilRollup();
+    ~SoilRollup();
+
+    // Allocates buckets, in PSRAM when available
+    bool begin();
+    void clear();
+
+    void add(uint8_t sensorId, uint32_t time, uint16_t value);
+    // Copies buckets of one sensor and tier, oldest first. Returns number copied.
+    size_t read(uint8_t sensorId, rollup_tier_t tier, RollupBucket *out, size_t maxCount) const;
+
+    static uint32_t period(rollup_tier_t tier) { return tier == ROLLUP_DAY ? 86400 : 3600; }
+    static size_t capacity(rollup_tier_t tier) { return tier == ROLLUP_DAY ? ROLLUP_DAYS : ROLLUP_HOURS; }
+
+private:
+    struct Tier {
+        RollupBucket *buckets;
+        size_t head;  // next bucket to start
+        size_t count; // buckets in use
+    };
+
+    static uint32_t bucketStart(rollup_tier_t tier, uint32_t time);
+    static void addTo(Tier &t, rollup_tier_t tier, uint32_t time, uint16_t value);
+
+    RollupBucket *storage;
+    Tier tiers[ROLLUP_SENSORS][ROLLUP_TIER_COUNT];
+};
@@ -0,0 +1,144 @@
+#include "SoilStats.h"
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+SoilStats::SoilStats() : start(0), light(false), hasPrevious(false)
+{
+  memset(sensors, 0, sizeof(sensors));
+  memset(&previous, 0, sizeof(previous));
+}
+
+// Start of the light or dark phase containing time, on whole local hours
+uint32_t SoilStats::phaseStart(uint32_t time, int lightStart, int lightEnd, bool &light)
+{
+  time_t t = time;
+  struct tm timeinfo;
+  localtime_r(&t, &timeinfo);
+  int hour = timeinfo.tm_hour;
+  // same convention as the config: light from lightStart up to lightEnd, may wrap midnight
+  light = lightStart < lightEnd ? (hour >= lightStart && hour < lightEnd)
+                                : (hour >= lightStart || hour < lightEnd);
+  int boundary = light ? lightStart : lightEnd;
+  int hoursSince = (hour - boundary + 24) % 24;
+  return time - (hoursSince * 3600 + timeinfo.tm_min * 60 + timeinfo.tm_sec);
+}
+
+SoilSummary SoilStats::summarize(const Accumulator &a)
+{
+  SoilSummary s;
+  memset(&s, 0, sizeof(s));
+  s.count = a.count;
+  if (!a.count)
+    return s;
+  s.last = a.last;
+  s.min = a.min;
+  s.max = a.max;
+  s.mean = (float)a.mean;
+  s.stddev = a.count > 1 ? (float)sqrt(a.m2 / (a.count - 1)) : 0.0f;
+  s.ewma = a.ewma;
+
+  // x in hours before the newest reading, keeps the sums small
+  size_t n = a.count < SOIL_STATS_SLOPE_N ? a.count : SOIL_STATS_SLOPE_N;
+  uint32_t newest = a.times[(a.head + SOIL_STATS_SLOPE_N - 1) % SOIL_STATS_SLOPE_N];
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t slot = (a.head + SOIL_STATS_SLOPE_N - 1 - i) % SOIL_STATS_SLOPE_N;
+    double x = -((double)(newest - a.times[slot])) / 3600.0;
+    double y = a.values[slot];
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+  }
+  double denom = n * sxx - sx * sx;
+  if (n > 1 && denom > 1e-9)
+    s.slope = (float)((n * sxy - sx * sy) / denom);
+  return s;
+}
+
+// Finishes the running phase and starts a new one, mutex held
+void SoilStats::rollTo(uint32_t phase, bool phaseLight, uint32_t now)
+{
+  bool any = false;
+  for (int i = 0; i < SOIL_STATS_SENSORS; i++)
+    any |= sensors[i].count != 0;
+  // a dark phase (pre-dawn readings at most) never replaces the last light cycle
+  if (any && light)
+  {
+    previous.start = start;
+    // a light hour changed in the config can move the new phase start before the old one
+    previous.end = phase > start ? phase : now;
+    previous.light = light;
+    for (int i = 0; i < SOIL_STATS_SENSORS; i++)
+      previous.sensors[i] = summarize(sensors[i]);
+    hasPrevious = true;
+  }
+  memset(sensors, 0, sizeof(sensors));
+  start = phase;
+  light = phaseLight;
+}
+
+void SoilStats::add(uint8_t sensorId, uint32_t time, uint16_t value, int lightStart, int lightEnd)
+{
+  if (sensorId >= SOIL_STATS_SENSORS)
+    return;
+  bool phaseLight;
+  uint32_t phase = phaseStart(time, lightStart, lightEnd, phaseLight);
+  if (!mutex.lock())
+    return;
+
+  // a reading from before the running phase (clock stepped back) is dropped,
+  // its phase is already summarized or gone
+  if (phase != start && time >= start)
+    rollTo(phase, phaseLight, time);
+  if (phase == start)
+  {
+    Accumulator &a = sensors[sensorId];
+    a.count++;
+    a.last = value;
+    if (a.count == 1)
+    {
+      a.min = a.max = value;
+      a.ewma = value;
+    }
+    else
+    {
+      if (value < a.min)
+        a.min = value;
+      if (value > a.max)
+        a.max = value;
+      a.ewma += SOIL_STATS_EWMA_ALPHA * (value - a.ewma);
+    }
+    double delta = value - a.mean;
+    a.mean += delta / a.count;
+    a.m2 += delta * (value - a.mean);
+    a.times[a.head] = time;
+    a.values[a.head] = value;
+    a.head = (a.head + 1) % SOIL_STATS_SLOPE_N;
+  }
+  mutex.unlock();
+}
+
+bool SoilStats::snapshot(uint32_t now, int lightStart, int lightEnd, SoilCycle &current, SoilCycle &prev)
+{
+  bool phaseLight;
+  uint32_t phase = phaseStart(now, lightStart, lightEnd, phaseLight);
+  memset(&current, 0, sizeof(current));
+  memset(&prev, 0, sizeof(prev));
+  if (!mutex.lock())
+    return false;
+
+  if (phase != start && now >= start)
+    rollTo(phase, phaseLight, now);
+  current.start = start;
+  current.light = light;
+  for (int i = 0; i < SOIL_STATS_SENSORS; i++)
+    current.sensors[i] = summarize(sensors[i]);
+  prev = previous;
+  bool ok = hasPrevious;
+
+  mutex.unlock();
+  return ok;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "hal/Hal.h"
+
+// Running statistics of soil readings per sensor, per light cycle phase.
+//
+// Every reading updates its sensor in O(1): Welford mean and variance,
+// EWMA, min, max, last value and a ring of the last SOIL_STATS_SLOPE_N
+// readings for the trend. The day is split into phases at lightStart and
+// lightEnd (local time); when a reading or a snapshot() falls into a new
+// phase, all sensors roll over together. The previous cycle is the last
+// finished light phase: soil logging runs during the light cycle plus the
+// hour before it (Scheduler), so a dark phase only holds that pre-dawn hour
+// and would hide the light cycle the whole next day. Dark phase readings
+// still show in the running cycle. Readings come from the sensor task and
+// snapshots from HTTP handlers, so access is serialized by a mutex.
+
+#define SOIL_STATS_SENSORS 4
+#define SOIL_STATS_SLOPE_N 8       // readings in the trend window
+#define SOIL_STATS_EWMA_ALPHA 0.2f // weight of the newest reading
+
+struct SoilSummary {
+    uint32_t count;
+    uint16_t last;
+    uint16_t min;
+    uint16_t max;
+    float mean;
+    float stddev; // sample standard deviation, 0 below two readings
+    float ewma;
+    float slope;  // least squares trend of the last readings, counts per hour
+};
+
+struct SoilCycle {
+    uint32_t start; // phase start, epoch seconds
+    uint32_t end;   // start of the next phase, 0 while running
+    bool light;
+    SoilSummary sensors[SOIL_STATS_SENSORS];
+};
+
+class SoilStats {
+public:
+    SoilStats();
+
+    void add(uint8_t sensorId, uint32_t time, uint16_t value, int lightStart, int lightEnd);
+    // Rolls over if now is in a new phase, copies the running and the previous
+    // (last finished light) cycle. Returns false if no light cycle with
+    // readings has finished yet.
+    bool snapshot(uint32_t now, int lightStart, int lightEnd, SoilCycle &current, SoilCycle &previous);
+
+    hal::MutexStats getMutexStats() { return mutex.getStats(); }
+
+private:
+    struct Accumulator {
+        uint32_t count;
+        uint16_t last;
+        uint16_t min;
+        uint16_t max;
+        double mean;
+        double m2; // sum of squared deviations from the mean
+        float ewma;
+        uint32_t times[SOIL_STATS_SLOPE_N];
+        uint16_t values[SOIL_STATS_SLOPE_N];
+        uint8_t head; // next ring slot
+    };
+
+    static uint32_t phaseStart(uint32_t time, int lightStart, int lightEnd, bool &light);
+    static SoilSummary summarize(const Accumulator &a);
+    void rollTo(uint32_t phase, bool phaseLight, uint32_t now);
+
+    Accumulator sensors[SOIL_STATS_SENSORS];
+    uint32_t start; // running phase, 0 before the first reading
+    bool light;
+    SoilCycle previous; // last finished light phase with readings
+    bool hasPrevious;
+    hal::Mutex mutex;
+};
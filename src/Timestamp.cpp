@@ -0,0 +1,68 @@
+#include "Timestamp.h"
+#include <string.h>
+
+static inline void put2(char *p, unsigned v)
+{
+  p[0] = '0' + v / 10;
+  p[1] = '0' + v % 10;
+}
+
+TimestampFormatter::TimestampFormatter() : base(0), validFrom(0), validUntil(0)
+{
+  memset(date, 0, sizeof(date));
+}
+
+static inline int secondOfDay(const struct tm &tm)
+{
+  return tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+}
+
+void TimestampFormatter::refill(time_t t)
+{
+  struct tm tm;
+  localtime_r(&t, &tm);
+  base = t - secondOfDay(tm);
+
+  unsigned year = tm.tm_year + 1900;
+  put2(date, year / 100);
+  put2(date + 2, year % 100);
+  date[4] = '-';
+  put2(date + 5, tm.tm_mon + 1);
+  date[7] = '-';
+  put2(date + 8, tm.tm_mday);
+
+  // whole day only if the UTC offset is the same at both ends of it
+  struct tm first, last;
+  time_t lastSecond = base + 86399;
+  localtime_r(&base, &first);
+  localtime_r(&lastSecond, &last);
+  if (secondOfDay(first) == 0 && first.tm_mday == tm.tm_mday &&
+      secondOfDay(last) == 86399 && last.tm_mday == tm.tm_mday)
+  {
+    validFrom = base;
+    validUntil = base + 86400;
+  }
+  else
+  {
+    // DST changes happen on the hour
+    validFrom = t - (tm.tm_min * 60 + tm.tm_sec);
+    validUntil = validFrom + 3600;
+  }
+}
+
+size_t TimestampFormatter::format(char *buf, time_t t)
+{
+  if (t < validFrom || t >= validUntil)
+    refill(t);
+
+  unsigned sec = (unsigned)(t - base);
+  memcpy(buf, date, 10);
+  buf[10] = ' ';
+  put2(buf + 11, sec / 3600);
+  buf[13] = ':';
+  put2(buf + 14, sec / 60 % 60);
+  buf[16] = ':';
+  put2(buf + 17, sec % 60);
+  buf[TIMESTAMP_LEN] = '\0';
+  return TIMESTAMP_LEN;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>
+#include <time.h>
+
+// Local time as 'YYYY-MM-DD HH:MM:SS' for event lists.
+//
+// localtime_r() + strftime() per event dominated /logs rendering. The
+// formatter converts once per local day and caches the date text and the
+// epoch of local midnight; the time of day is then plain integer arithmetic.
+// On a day with a DST change the cache only covers the current hour, so the
+// result is always the same as strftime's.
+// Not thread safe, use one instance per stream.
+
+#define TIMESTAMP_LEN 19 // without terminator
+
+class TimestampFormatter {
+public:
+    TimestampFormatter();
+
+    // buf needs TIMESTAMP_LEN + 1 bytes, returns TIMESTAMP_LEN
+    size_t format(char *buf, time_t t);
+
+private:
+    void refill(time_t t);
+
+    time_t base;       // epoch of local midnight at the cached UTC offset
+    time_t validFrom;  // cache covers [validFrom, validUntil)
+    time_t validUntil;
+    char date[10];     // "YYYY-MM-DD"
+};
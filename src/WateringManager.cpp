@@ -0,0 +1,421 @@
+#include "WateringManager.h"
+#include <string.h>
+#include "LogManager.h"
+
+extern LogManager logManager;
+
+WateringManager::WateringManager(const int *valvePins, int pumpPin)
+    : valvePins(valvePins), pumpPin(pumpPin), queuedCount(0), lastJobId(0), runningJob(0), runningSource(WATERING_SOURCE_MANUAL), runningValves(0), jobStartMs(0), jobTotalSec(0)
+{
+  memset(jobs, 0, sizeof(jobs));
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool WateringManager::begin()
+{
+  return hal::startTask(taskEntry, "WateringTask", 4096, this, 1, 1);
+}
+
+WateringPlan WateringManager::plan(const FlowCalibration &cal, const int *volumesMl)
+{
+  WateringPlan p;
+  memset(&p, 0, sizeof(p));
+  uint32_t end[WATERING_VALVES] = {0};
+  uint8_t open = 0;
+  float openFlow = 0;
+  uint32_t t = 0;
+  for (int i = 0; i < WATERING_VALVES; i++)
+  {
+    int ml = volumesMl[i] < WATERING_MAX_VOLUME_ML ? volumesMl[i] : WATERING_MAX_VOLUME_ML;
+    if (ml <= 0)
+      continue;
+    float flow = cal.valveFlow[i];
+    p.volumeMl[i] = ml;
+    p.durationMs[i] = (uint32_t)(ml * 1000.0f / flow + 0.5f);
+
+    // wait for earlier valves to close until this one fits the pump's budget,
+    // a valve alone always runs
+    while (open && (cal.pumpFlow <= 0 || openFlow + flow > cal.pumpFlow))
+    {
+      uint32_t first = UINT32_MAX;
+      for (int j = 0; j < WATERING_VALVES; j++)
+        if ((open & (1 << j)) && end[j] < first)
+          first = end[j];
+      t = first;
+      for (int j = 0; j < WATERING_VALVES; j++)
+      {
+        if ((open & (1 << j)) && end[j] <= t)
+        {
+          open &= ~(1 << j);
+          openFlow -= cal.valveFlow[j];
+        }
+      }
+    }
+    p.startMs[i] = t;
+    end[i] = t + p.durationMs[i];
+    open |= 1 << i;
+    openFlow += flow;
+    if (end[i] > p.totalMs)
+      p.totalMs = end[i];
+  }
+  if (p.totalMs)
+    p.totalMs += WATERING_PRIME_SEC * 1000;
+  return p;
+}
+
+void WateringManager::volumesFor(const int *seconds, int *volumesMl) const
+{
+  for (int i = 0; i < WATERING_VALVES; i++)
+    volumesMl[i] = seconds[i] > 0 ? (int)(seconds[i] * calibration.valveFlow[i] + 0.5f) : 0;
+}
+
+uint32_t WateringManager::enqueue(const int *volumesMl, watering_source_t source, WateringPlan *plan)
+{
+  Job job;
+  job.source = source;
+  job.plan = WateringManager::plan(calibration, volumesMl);
+  if (plan)
+    *plan = job.plan;
+  if (!job.plan.totalMs)
+    return 0;
+
+  uint32_t id = 0;
+  if (mutex.lock())
+  {
+    if (queuedCount < WATERING_QUEUE_LENGTH)
+    {
+      // cancelled jobs free their queue place early, so IDs can run ahead of a job
+      // that is still queued or running; skip IDs whose record is taken by one
+      do
+        job.id = ++lastJobId;
+      while (job.id == 0 || jobs[job.id % WATERING_JOB_HISTORY].state == WATERING_JOB_QUEUED ||
+             jobs[job.id % WATERING_JOB_HISTORY].state == WATERING_JOB_RUNNING);
+      id = job.id;
+      queue[queuedCount++] = job;
+      JobRecord &r = jobs[job.id % WATERING_JOB_HISTORY];
+      r.id = job.id;
+      r.state = WATERING_JOB_QUEUED;
+      stats.accepted++;
+    }
+    else
+    {
+      stats.rejected++;
+    }
+    mutex.unlock();
+  }
+  if (id)
+    jobSignal.give();
+  return id;
+}
+
+bool WateringManager::cancel(uint32_t jobId)
+{
+  bool cancelled = false;
+  if (mutex.lock())
+  {
+    JobRecord &r = jobs[jobId % WATERING_JOB_HISTORY];
+    if (jobId != 0 && r.id == jobId && (r.state == WATERING_JOB_QUEUED || r.state == WATERING_JOB_RUNNING))
+    {
+      if (r.state == WATERING_JOB_QUEUED)
+      {
+        // take it out so its place is free at once
+        size_t i = 0;
+        while (i < queuedCount && queue[i].id != jobId)
+          i++;
+        for (; i + 1 < queuedCount; i++)
+          queue[i] = queue[i + 1];
+        queuedCount--;
+      }
+      else
+      {
+        cancelSignal.give();
+      }
+      r.state = WATERING_JOB_CANCELLED;
+      stats.cancelled++;
+      cancelled = true;
+    }
+    mutex.unlock();
+  }
+  return cancelled;
+}
+
+size_t WateringManager::cancelAll()
+{
+  size_t n = 0;
+  if (mutex.lock())
+  {
+    for (JobRecord &r : jobs)
+    {
+      if (r.state != WATERING_JOB_QUEUED && r.state != WATERING_JOB_RUNNING)
+        continue;
+      if (r.state == WATERING_JOB_RUNNING)
+        cancelSignal.give();
+      r.state = WATERING_JOB_CANCELLED;
+      stats.cancelled++;
+      n++;
+    }
+    queuedCount = 0;
+    mutex.unlock();
+  }
+  return n;
+}
+
+watering_job_state_t WateringManager::getJobState(uint32_t jobId) const
+{
+  watering_job_state_t state = WATERING_JOB_UNKNOWN;
+  if (mutex.lock())
+  {
+    const JobRecord &r = jobs[jobId % WATERING_JOB_HISTORY];
+    if (jobId != 0 && r.id == jobId)
+      state = r.state;
+    mutex.unlock();
+  }
+  return state;
+}
+
+size_t WateringManager::queuedJobs() const
+{
+  size_t n = 0;
+  if (mutex.lock())
+  {
+    n = queuedCount;
+    mutex.unlock();
+  }
+  return n;
+}
+
+WateringStats WateringManager::getStats() const
+{
+  WateringStats s;
+  memset(&s, 0, sizeof(s));
+  if (mutex.lock())
+  {
+    s = stats;
+    mutex.unlock();
+  }
+  return s;
+}
+
+WateringStatus WateringManager::getStatus() const
+{
+  WateringStatus status = {0, 0, WATERING_SOURCE_MANUAL, -1, 0, 0, 0};
+  if (mutex.lock())
+  {
+    status.queued = queuedCount;
+    status.runningJob = runningJob;
+    if (runningJob)
+    {
+      status.source = runningSource;
+      status.valveMask = runningValves;
+      status.valve = runningValves ? __builtin_ctz(runningValves) : -1;
+      status.elapsedSec = (hal::uptimeMs() - jobStartMs) / 1000;
+      status.totalSec = jobTotalSec;
+    }
+    mutex.unlock();
+  }
+  return status;
+}
+
+void WateringManager::taskEntry(void *param)
+{
+  ((WateringManager *)param)->run();
+}
+
+bool WateringManager::takeJob(Job &job)
+{
+  bool run = false;
+  if (mutex.lock())
+  {
+    if (queuedCount > 0)
+    {
+      job = queue[0];
+      for (size_t i = 1; i < queuedCount; i++)
+        queue[i - 1] = queue[i];
+      queuedCount--;
+      jobs[job.id % WATERING_JOB_HISTORY].state = WATERING_JOB_RUNNING;
+      runningJob = job.id;
+      runningSource = job.source;
+      runningValves = 0;
+      jobStartMs = hal::uptimeMs();
+      jobTotalSec = (job.plan.totalMs + 999) / 1000;
+      run = true;
+    }
+    mutex.unlock();
+  }
+  // a cancel aimed at an earlier job must not stop this one
+  cancelSignal.wait(0);
+  return run;
+}
+
+void WateringManager::finishJob(uint32_t jobId)
+{
+  if (mutex.lock())
+  {
+    JobRecord &r = jobs[jobId % WATERING_JOB_HISTORY];
+    if (r.id == jobId && r.state == WATERING_JOB_RUNNING)
+    {
+      r.state = WATERING_JOB_DONE;
+      stats.done++;
+    }
+    runningJob = 0;
+    runningValves = 0;
+    mutex.unlock();
+  }
+}
+
+bool WateringManager::waitCancelled(uint32_t ms)
+{
+  cancelSignal.wait(ms);
+  bool cancelled = true;
+  if (mutex.lock())
+  {
+    const JobRecord &r = jobs[runningJob % WATERING_JOB_HISTORY];
+    cancelled = r.id != runningJob || r.state != WATERING_JOB_RUNNING;
+    mutex.unlock();
+  }
+  return cancelled;
+}
+
+void WateringManager::setValves(uint8_t mask)
+{
+  if (mutex.lock())
+  {
+    runningValves = mask;
+    mutex.unlock();
+  }
+}
+
+// Closes one valve, elapsedMs is plan time (negative while priming)
+void WateringManager::closeValve(int valve, const WateringPlan &plan, int32_t elapsedMs)
+{
+  hal::pinWrite(valvePins[valve], false); // Valve OFF
+
+  // priming is not watering, a cancelled valve counts up to the cancel
+  int64_t ms = (int64_t)elapsedMs - plan.startMs[valve];
+  if (ms < 0)
+    ms = 0;
+  if (ms > plan.durationMs[valve])
+    ms = plan.durationMs[valve];
+  uint32_t seconds = (uint32_t)((ms + 500) / 1000);
+  uint32_t ml = (uint32_t)(plan.volumeMl[valve] * ms / plan.durationMs[valve]);
+  logManager.addWaterEvent(valve, seconds);
+  if (mutex.lock())
+  {
+    stats.wateredSec[valve] += seconds;
+    stats.wateredMl[valve] += ml;
+    mutex.unlock();
+  }
+}
+
+void WateringManager::execute(const WateringPlan &plan)
+{
+  uint8_t pending = 0;
+  for (int i = 0; i < WATERING_VALVES; i++)
+    if (plan.durationMs[i])
+      pending |= 1 << i;
+
+  // valves starting at 0 open with the pump and stay open while it primes
+  uint8_t open = 0;
+  for (int i = 0; i < WATERING_VALVES; i++)
+  {
+    if ((pending & (1 << i)) && plan.startMs[i] == 0)
+    {
+      hal::pinWrite(valvePins[i], true); // Valve ON (active HIGH)
+      open |= 1 << i;
+    }
+  }
+  pending &= ~open;
+  uint32_t pumpStart = hal::uptimeMs();
+  hal::pinWrite(pumpPin, false); // Pump ON (active LOW)
+  setValves(open);
+  uint32_t origin = pumpStart + WATERING_PRIME_SEC * 1000; // plan time 0
+
+  while (open)
+  {
+    // next valve to close or to open
+    uint32_t next = UINT32_MAX;
+    for (int i = 0; i < WATERING_VALVES; i++)
+    {
+      if ((open & (1 << i)) && plan.startMs[i] + plan.durationMs[i] < next)
+        next = plan.startMs[i] + plan.durationMs[i];
+      if ((pending & (1 << i)) && plan.startMs[i] < next)
+        next = plan.startMs[i];
+    }
+    int32_t elapsed = (int32_t)(hal::uptimeMs() - origin);
+    if ((int64_t)next > elapsed && waitCancelled((uint32_t)(next - elapsed)))
+      break;
+    elapsed = (int32_t)(hal::uptimeMs() - origin);
+
+    // open the next valves before closing the finished ones
+    for (int i = 0; i < WATERING_VALVES; i++)
+    {
+      if ((pending & (1 << i)) && (int64_t)plan.startMs[i] <= elapsed)
+      {
+        hal::pinWrite(valvePins[i], true); // Valve ON
+        pending &= ~(1 << i);
+        open |= 1 << i;
+      }
+    }
+    uint8_t closing = 0;
+    for (int i = 0; i < WATERING_VALVES; i++)
+      if ((open & (1 << i)) && (int64_t)(plan.startMs[i] + plan.durationMs[i]) <= elapsed)
+        closing |= 1 << i;
+    // pump stops before the last valves close
+    if (closing == open && !pending)
+      break;
+    for (int i = 0; i < WATERING_VALVES; i++)
+      if (closing & (1 << i))
+        closeValve(i, plan, elapsed);
+    open &= ~closing;
+    setValves(open);
+  }
+
+  hal::pinWrite(pumpPin, true); // Pump OFF
+  int32_t elapsed = (int32_t)(hal::uptimeMs() - origin);
+  for (int i = 0; i < WATERING_VALVES; i++)
+    if (open & (1 << i))
+      closeValve(i, plan, elapsed);
+  setValves(0);
+  if (mutex.lock())
+  {
+    stats.pumpMs += hal::uptimeMs() - pumpStart;
+    mutex.unlock();
+  }
+}
+
+void WateringManager::run()
+{
+  bool active = false;
+  Job job;
+  for (;;)
+  {
+    // stay busy while more jobs are waiting
+    if (active && queuedJobs() == 0)
+    {
+      active = false;
+      if (activeListener)
+        activeListener(false);
+    }
+
+    if (!takeJob(job))
+    {
+      jobSignal.wait(HAL_WAIT_FOREVER);
+      continue;
+    }
+
+    if (!active && activeListener)
+      activeListener(true);
+    active = true;
+
+    // reading soil sensors of the job's valves while the pump is still off
+    uint8_t valves = 0;
+    for (int i = 0; i < WATERING_VALVES; i++)
+      if (job.plan.durationMs[i])
+        valves |= 1 << i;
+    if (valveHook)
+      valveHook(valves);
+    if (!waitCancelled(0))
+      execute(job.plan);
+    finishJob(job.id);
+  }
+}
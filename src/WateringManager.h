@@ -0,0 +1,155 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "Calibration.h"
+#include "hal/Hal.h"
+
+// Watering executor.
+//
+// One long-lived worker task owns the pump and valve relays and runs watering
+// jobs from a bounded queue, one after another. Scheduled and manual jobs that
+// overlap are queued instead of rejected. Queued jobs can be cancelled before
+// they start, which frees their place in the queue; cancelling the running job
+// closes its valves at once.
+//
+// Jobs are volume targets in ml per valve, turned into open times with the
+// calibrated flow rates (Calibration.h) when queued. A job primes the pump
+// once and then runs its valves as a pipeline: each valve opens as soon as the
+// flow of the valves already open plus its own fits the pump's budget (one at
+// a time while the budget is unknown), and a valve taking over from another
+// opens before that one closes, so the pump runs without a break and never
+// against closed valves.
+// Job IDs stay queryable for the last WATERING_JOB_HISTORY jobs.
+
+#define WATERING_VALVES 4
+#define WATERING_QUEUE_LENGTH 8
+#define WATERING_JOB_HISTORY 16 // must exceed WATERING_QUEUE_LENGTH + 1 (running job)
+#define WATERING_PRIME_SEC 3    // pump runs this long before the first valves count as watering
+#define WATERING_MAX_VOLUME_ML 10000 // per valve and job
+
+static_assert(WATERING_VALVES == CALIBRATION_VALVES, "one calibration entry per valve");
+
+typedef enum
+{
+  WATERING_JOB_UNKNOWN,   //!< Never issued or too old
+  WATERING_JOB_QUEUED,    //!< Waiting for the worker
+  WATERING_JOB_RUNNING,   //!< Being watered
+  WATERING_JOB_DONE,      //!< All valves finished
+  WATERING_JOB_CANCELLED  //!< Cancelled before or while running
+} watering_job_state_t;
+
+typedef enum
+{
+  WATERING_SOURCE_MANUAL,   //!< POST /watering
+  WATERING_SOURCE_SCHEDULE  //!< config.wateringSchedules
+} watering_source_t;
+
+// Valve timeline of one job, times relative to the end of pump priming
+struct WateringPlan {
+    uint16_t volumeMl[WATERING_VALVES];   // target, 0 when the valve is skipped
+    uint32_t startMs[WATERING_VALVES];
+    uint32_t durationMs[WATERING_VALVES];
+    uint32_t totalMs;                     // pump run time, priming included
+};
+
+// Snapshot of the executor for the API
+struct WateringStatus {
+    size_t queued;        // jobs waiting, excluding the running one
+    uint32_t runningJob;  // 0 when idle
+    watering_source_t source;
+    int valve;            // lowest open valve, -1 while none is open
+    uint8_t valveMask;    // bit per open valve
+    uint32_t elapsedSec;  // since running job started
+    uint32_t totalSec;    // planned duration of running job
+};
+
+// Counters since boot, for /metrics
+struct WateringStats {
+    uint32_t accepted;  // jobs queued
+    uint32_t rejected;  // queue was full
+    uint32_t done;
+    uint32_t cancelled; // before or while running
+    uint32_t wateredSec[WATERING_VALVES];
+    uint32_t wateredMl[WATERING_VALVES];
+    uint64_t pumpMs;    // pump run time, priming included
+};
+
+class WateringManager {
+public:
+    WateringManager(const int *valvePins, int pumpPin);
+
+    // Flow rates jobs are planned with. Not locked: set before begin() and before
+    // anything (scheduler, HTTP handlers) can call enqueue() or volumesFor()
+    void setCalibration(const FlowCalibration &cal) { calibration = cal; }
+    const FlowCalibration &getCalibration() const { return calibration; }
+
+    // Starts the worker task (pinned to core 1)
+    bool begin();
+
+    // Queues a job with per-valve volumes in ml (0 skips a valve), never blocks.
+    // Returns job ID, 0 if the queue is full or no valve has a volume.
+    // plan, if given, receives the job's valve timeline.
+    uint32_t enqueue(const int *volumesMl, watering_source_t source, WateringPlan *plan = nullptr);
+    // Volumes that open times in seconds deliver at the calibrated flow rates
+    void volumesFor(const int *seconds, int *volumesMl) const;
+    // Valve timeline for volumes in ml, in valve order within the pump's flow budget
+    static WateringPlan plan(const FlowCalibration &cal, const int *volumesMl);
+    // Cancels a queued or running job, false if it already finished or is unknown
+    bool cancel(uint32_t jobId);
+    // Cancels the running job and everything queued, returns number of jobs cancelled
+    size_t cancelAll();
+
+    watering_job_state_t getJobState(uint32_t jobId) const;
+    WateringStatus getStatus() const;
+    WateringStats getStats() const;
+    hal::MutexStats getMutexStats() const { return mutex.getStats(); }
+
+    // Called by the worker before the pump starts with a bit per valve of the job
+    // (e.g. to read those valves' soil sensors)
+    typedef void (*ValveHook)(uint8_t valves);
+    void setValveHook(ValveHook hook) { valveHook = hook; }
+    // Called by the worker when the pump becomes busy / idle. Set both before begin().
+    typedef void (*ActiveListener)(bool active);
+    void setActiveListener(ActiveListener listener) { activeListener = listener; }
+
+private:
+    struct Job {
+        uint32_t id;
+        watering_source_t source;
+        WateringPlan plan;
+    };
+    struct JobRecord {
+        uint32_t id;
+        watering_job_state_t state;
+    };
+
+    static void taskEntry(void *param);
+    void run();
+    bool takeJob(Job &job); // pops the oldest queued job and marks it running, false if none
+    void finishJob(uint32_t jobId);
+    bool waitCancelled(uint32_t ms); // sleeps, true if running job got cancelled meanwhile
+    void execute(const WateringPlan &plan);
+    void closeValve(int valve, const WateringPlan &plan, int32_t elapsedMs);
+    void setValves(uint8_t mask);
+    size_t queuedJobs() const;
+
+    const int *valvePins;
+    int pumpPin;
+    hal::Signal jobSignal;       // wakes the idle worker when a job is queued
+    hal::Signal cancelSignal;    // interrupts the worker's waits
+    mutable hal::Mutex mutex;    // guards everything below
+    // FIFO of queued jobs, kept under the mutex so cancel() can take jobs out
+    Job queue[WATERING_QUEUE_LENGTH];
+    size_t queuedCount;
+    JobRecord jobs[WATERING_JOB_HISTORY]; // indexed by id % WATERING_JOB_HISTORY
+    uint32_t lastJobId;
+    uint32_t runningJob;
+    watering_source_t runningSource;
+    uint8_t runningValves;
+    uint32_t jobStartMs;
+    uint32_t jobTotalSec;
+    WateringStats stats;
+    FlowCalibration calibration;
+    ValveHook valveHook = nullptr;
+    ActiveListener activeListener = nullptr;
+};
@@ -0,0 +1,224 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <functional>
+#include <string>
+
+// Thin hardware abstraction for the controller logic.
+//
+// Everything below the web server (log storage, journal, config, scheduling,
+// watering sequencing) talks to the board only through this header, so the
+// same code builds for the ESP32 (HalEsp32.cpp: Arduino + FreeRTOS, LittleFS,
+// NVS) and for a Linux host (HalPosix.cpp: std::thread, a directory as file
+// system, in-memory NVS), see [env:native] in platformio.ini.
+// Exactly one backend is compiled, ARDUINO selects the ESP32 one.
+
+#define HAL_WAIT_FOREVER 0xffffffffu
+
+namespace hal
+{
+
+// --- GPIO / ADC ---
+void pinOutput(int pin);
+void pinInput(int pin);
+void pinWrite(int pin, bool high);
+int adcRead(int pin); // raw 12 bit reading
+
+// --- Clock ---
+time_t now();         // wall clock, epoch seconds (NTP synced on the device)
+uint32_t uptimeMs();  // monotonic, wraps after ~49 days
+uint64_t uptimeUs();  // monotonic, for timing measurements
+void sleepMs(uint32_t ms);
+
+// --- Memory ---
+bool hasPsram();
+// Large buffers, placed in PSRAM when the board has it. Release with free().
+void *allocLarge(size_t bytes);
+
+struct HeapStats {
+    size_t freeBytes;        // internal RAM
+    size_t minFreeBytes;     // lowest freeBytes since boot
+    size_t largestFreeBlock; // biggest single internal allocation possible now
+    size_t psramFreeBytes;
+};
+// Heap watermarks, all zero on the host
+HeapStats heapStats();
+
+// --- Logging ---
+// printf style line to the debug console, caller adds the newline
+void logf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// --- Tasks ---
+typedef void (*TaskFunction)(void *arg);
+// Starts fn(arg) in its own task. fn may return, the task is cleaned up then.
+// core pins the task on the ESP32, ignored on the host.
+bool startTask(TaskFunction fn, const char *name, uint32_t stackBytes, void *arg, int priority, int core);
+
+// Lock statistics, times in microseconds, kept since boot
+struct MutexStats {
+    uint32_t acquisitions;
+    uint32_t contended;  // acquisitions that had to wait
+    uint64_t waitUs;     // total time spent waiting
+    uint64_t holdUs;     // total time held
+    uint32_t maxWaitUs;
+    uint32_t maxHoldUs;
+};
+
+// Every mutex keeps MutexStats: an uncontended lock costs one extra timestamp,
+// unlock one more. Stats are updated while the mutex is held.
+class Mutex {
+public:
+    Mutex();
+    ~Mutex();
+    Mutex(const Mutex &) = delete;
+    Mutex &operator=(const Mutex &) = delete;
+
+    // Waits up to timeoutMs (0 = try only), true when the mutex was taken
+    bool lock(uint32_t timeoutMs = HAL_WAIT_FOREVER)
+    {
+        bool taken = take(0);
+        uint32_t waitUs = 0;
+        if (!taken && timeoutMs != 0)
+        {
+            uint64_t start = uptimeUs();
+            taken = take(timeoutMs);
+            waitUs = (uint32_t)(uptimeUs() - start);
+        }
+        if (!taken)
+            return false;
+        lockedAtUs = uptimeUs();
+        stats.acquisitions++;
+        if (waitUs)
+        {
+            stats.contended++;
+            stats.waitUs += waitUs;
+            if (waitUs > stats.maxWaitUs)
+                stats.maxWaitUs = waitUs;
+        }
+        return true;
+    }
+
+    void unlock()
+    {
+        uint32_t heldUs = (uint32_t)(uptimeUs() - lockedAtUs);
+        stats.holdUs += heldUs;
+        if (heldUs > stats.maxHoldUs)
+            stats.maxHoldUs = heldUs;
+        give();
+    }
+
+    // Consistent copy of the stats, taken under the mutex (counts as one acquisition)
+    MutexStats getStats()
+    {
+        MutexStats s = {};
+        if (lock())
+        {
+            s = stats;
+            unlock();
+        }
+        return s;
+    }
+
+private:
+    bool take(uint32_t timeoutMs);
+    void give();
+
+    void *handle;
+    uint64_t lockedAtUs = 0;
+    MutexStats stats = {};
+};
+
+// Bounded FIFO of fixed size items (FreeRTOS queue on the ESP32)
+class Queue {
+public:
+    Queue(size_t length, size_t itemSize);
+    ~Queue();
+    Queue(const Queue &) = delete;
+    Queue &operator=(const Queue &) = delete;
+
+    // Copies item in, waits up to timeoutMs for space (0 = fail at once when full)
+    bool send(const void *item, uint32_t timeoutMs = 0);
+    bool receive(void *item, uint32_t timeoutMs = HAL_WAIT_FOREVER);
+    size_t count() const;
+
+private:
+    void *handle;
+};
+
+// Wakes one waiting task early, e.g. to interrupt a timed wait (binary semaphore on the ESP32).
+// A signal given while nobody waits is kept until the next wait().
+class Signal {
+public:
+    Signal();
+    ~Signal();
+    Signal(const Signal &) = delete;
+    Signal &operator=(const Signal &) = delete;
+
+    void give();
+    // Waits up to timeoutMs, true if signaled (the signal is consumed)
+    bool wait(uint32_t timeoutMs);
+
+private:
+    void *handle;
+};
+
+// --- Non-volatile key/value storage, one namespace open at a time per object ---
+class Nvs {
+public:
+    Nvs();
+    ~Nvs();
+    Nvs(const Nvs &) = delete;
+    Nvs &operator=(const Nvs &) = delete;
+
+    bool begin(const char *ns, bool readOnly);
+    void end();
+    bool isKey(const char *key);
+    bool clear();
+
+    int32_t getInt(const char *key, int32_t defaultValue);
+    bool putInt(const char *key, int32_t value);
+    std::string getString(const char *key, const char *defaultValue);
+    bool putString(const char *key, const std::string &value);
+    size_t getBytesLength(const char *key); // 0 if missing
+    size_t getBytes(const char *key, void *buf, size_t maxLen);
+    bool putBytes(const char *key, const void *buf, size_t len);
+    bool remove(const char *key);
+
+private:
+    void *handle;
+};
+
+// --- Files (LittleFS on the ESP32, a host directory on POSIX) ---
+bool fsMount();
+bool fsExists(const char *path);
+bool fsMkdir(const char *path);
+bool fsRemove(const char *path);
+// Calls fn with the name (not the path) of every file in dir
+void fsList(const char *dir, const std::function<void(const char *name)> &fn);
+
+class File {
+public:
+    File();
+    ~File();
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+
+    bool open(const char *path, const char *mode); // "r", "w" or "a"
+    void close();
+    bool isOpen() const { return handle != nullptr; }
+    size_t read(void *buf, size_t len);
+    size_t write(const void *buf, size_t len);
+    bool seek(size_t pos); // absolute position
+    size_t size();
+
+private:
+    void *handle;
+};
+
+#ifndef ARDUINO
+// Host only: moves now() and uptime forward, lets simulations run days in seconds
+void advanceClock(uint32_t seconds);
+#endif
+
+} // namespace hal
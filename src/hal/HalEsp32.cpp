@@ -0,0 +1,218 @@
+#ifdef ARDUINO
+#include "Hal.h"
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <stdarg.h>
+
+namespace hal
+{
+
+void pinOutput(int pin) { pinMode(pin, OUTPUT); }
+void pinInput(int pin) { pinMode(pin, INPUT); }
+void pinWrite(int pin, bool high) { digitalWrite(pin, high ? HIGH : LOW); }
+int adcRead(int pin) { return analogRead(pin); }
+
+time_t now() { return time(nullptr); }
+uint32_t uptimeMs() { return millis(); }
+uint64_t uptimeUs() { return (uint64_t)esp_timer_get_time(); }
+void sleepMs(uint32_t ms) { vTaskDelay(pdMS_TO_TICKS(ms)); }
+
+bool hasPsram() { return psramFound(); }
+
+void *allocLarge(size_t bytes)
+{
+  void *p = nullptr;
+  if (psramFound())
+    p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+  return p ? p : malloc(bytes);
+}
+
+HeapStats heapStats()
+{
+  HeapStats s;
+  s.freeBytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+  s.minFreeBytes = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+  s.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+  s.psramFreeBytes = psramFound() ? heap_caps_get_free_size(MALLOC_CAP_SPIRAM) : 0;
+  return s;
+}
+
+void logf(const char *fmt, ...)
+{
+  char buf[192];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  Serial.print(buf);
+}
+
+// --- Tasks ---
+struct TaskStart {
+    TaskFunction fn;
+    void *arg;
+};
+
+static void taskTrampoline(void *param)
+{
+  TaskStart start = *(TaskStart *)param;
+  delete (TaskStart *)param;
+  start.fn(start.arg);
+  vTaskDelete(NULL); // FreeRTOS tasks must not return
+}
+
+bool startTask(TaskFunction fn, const char *name, uint32_t stackBytes, void *arg, int priority, int core)
+{
+  TaskStart *start = new TaskStart{fn, arg};
+  if (xTaskCreatePinnedToCore(taskTrampoline, name, stackBytes, start, priority, NULL, core) != pdPASS)
+  {
+    delete start;
+    return false;
+  }
+  return true;
+}
+
+Mutex::Mutex() : handle(xSemaphoreCreateMutex()) {}
+
+Mutex::~Mutex()
+{
+  vSemaphoreDelete((SemaphoreHandle_t)handle);
+}
+
+static TickType_t toTicks(uint32_t timeoutMs)
+{
+  return timeoutMs == HAL_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+}
+
+bool Mutex::take(uint32_t timeoutMs)
+{
+  return xSemaphoreTake((SemaphoreHandle_t)handle, toTicks(timeoutMs)) == pdTRUE;
+}
+
+void Mutex::give()
+{
+  xSemaphoreGive((SemaphoreHandle_t)handle);
+}
+
+Queue::Queue(size_t length, size_t itemSize) : handle(xQueueCreate(length, itemSize)) {}
+
+Queue::~Queue()
+{
+  vQueueDelete((QueueHandle_t)handle);
+}
+
+bool Queue::send(const void *item, uint32_t timeoutMs)
+{
+  return xQueueSend((QueueHandle_t)handle, item, toTicks(timeoutMs)) == pdTRUE;
+}
+
+bool Queue::receive(void *item, uint32_t timeoutMs)
+{
+  return xQueueReceive((QueueHandle_t)handle, item, toTicks(timeoutMs)) == pdTRUE;
+}
+
+size_t Queue::count() const
+{
+  return uxQueueMessagesWaiting((QueueHandle_t)handle);
+}
+
+Signal::Signal() : handle(xSemaphoreCreateBinary()) {}
+
+Signal::~Signal()
+{
+  vSemaphoreDelete((SemaphoreHandle_t)handle);
+}
+
+void Signal::give()
+{
+  xSemaphoreGive((SemaphoreHandle_t)handle);
+}
+
+bool Signal::wait(uint32_t timeoutMs)
+{
+  return xSemaphoreTake((SemaphoreHandle_t)handle, toTicks(timeoutMs)) == pdTRUE;
+}
+
+// --- NVS ---
+#define PREFS ((Preferences *)handle)
+
+Nvs::Nvs() : handle(new Preferences()) {}
+Nvs::~Nvs() { delete PREFS; }
+
+bool Nvs::begin(const char *ns, bool readOnly) { return PREFS->begin(ns, readOnly); }
+void Nvs::end() { PREFS->end(); }
+bool Nvs::isKey(const char *key) { return PREFS->isKey(key); }
+bool Nvs::clear() { return PREFS->clear(); }
+
+int32_t Nvs::getInt(const char *key, int32_t defaultValue) { return PREFS->getInt(key, defaultValue); }
+bool Nvs::putInt(const char *key, int32_t value) { return PREFS->putInt(key, value) == sizeof(int32_t); }
+
+std::string Nvs::getString(const char *key, const char *defaultValue)
+{
+  String value = PREFS->getString(key, defaultValue);
+  return std::string(value.c_str(), value.length());
+}
+
+bool Nvs::putString(const char *key, const std::string &value)
+{
+  return PREFS->putString(key, value.c_str()) == value.size();
+}
+
+size_t Nvs::getBytesLength(const char *key) { return PREFS->isKey(key) ? PREFS->getBytesLength(key) : 0; }
+size_t Nvs::getBytes(const char *key, void *buf, size_t maxLen) { return PREFS->getBytes(key, buf, maxLen); }
+bool Nvs::putBytes(const char *key, const void *buf, size_t len) { return PREFS->putBytes(key, buf, len) == len; }
+bool Nvs::remove(const char *key) { return PREFS->remove(key); }
+
+#undef PREFS
+
+// --- Files ---
+bool fsMount() { return LittleFS.begin(true); }
+bool fsExists(const char *path) { return LittleFS.exists(path); }
+bool fsMkdir(const char *path) { return LittleFS.mkdir(path); }
+bool fsRemove(const char *path) { return LittleFS.remove(path); }
+
+void fsList(const char *dir, const std::function<void(const char *name)> &fn)
+{
+  fs::File d = LittleFS.open(dir);
+  if (!d || !d.isDirectory())
+    return;
+  for (fs::File f = d.openNextFile(); f; f = d.openNextFile())
+    fn(f.name());
+  d.close();
+}
+
+#define FILE_PTR ((fs::File *)handle)
+
+File::File() : handle(nullptr) {}
+File::~File() { close(); }
+
+bool File::open(const char *path, const char *mode)
+{
+  close();
+  fs::File f = LittleFS.open(path, mode);
+  if (!f)
+    return false;
+  handle = new fs::File(f);
+  return true;
+}
+
+void File::close()
+{
+  if (!handle)
+    return;
+  FILE_PTR->close();
+  delete FILE_PTR;
+  handle = nullptr;
+}
+
+size_t File::read(void *buf, size_t len) { return handle ? FILE_PTR->read((uint8_t *)buf, len) : 0; }
+size_t File::write(const void *buf, size_t len) { return handle ? FILE_PTR->write((const uint8_t *)buf, len) : 0; }
+bool File::seek(size_t pos) { return handle && FILE_PTR->seek(pos); }
+size_t File::size() { return handle ? FILE_PTR->size() : 0; }
+
+#undef FILE_PTR
+
+} // namespace hal
+#endif
@@ -0,0 +1,358 @@
+#ifndef ARDUINO
+#include "Hal.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <dirent.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Host backend for env:native.
+// GPIO writes are dropped, ADC reads return a mid-scale value, files live in
+// the directory named by HAL_FS_ROOT (default ./native_fs), NVS is kept in
+// memory for the lifetime of the process.
+
+namespace hal
+{
+
+static std::atomic<int64_t> clockOffset(0); // seconds added by advanceClock()
+
+void pinOutput(int) {}
+void pinInput(int) {}
+void pinWrite(int, bool) {}
+int adcRead(int) { return 2048; }
+
+time_t now() { return time(nullptr) + clockOffset.load(); }
+
+uint64_t uptimeUs()
+{
+  static const auto start = std::chrono::steady_clock::now();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + clockOffset.load() * 1000000;
+}
+
+uint32_t uptimeMs() { return (uint32_t)(uptimeUs() / 1000); }
+void sleepMs(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+void advanceClock(uint32_t seconds) { clockOffset += seconds; }
+
+bool hasPsram() { return true; } // sized like the N16R8 board
+void *allocLarge(size_t bytes) { return malloc(bytes); }
+HeapStats heapStats() { return HeapStats{0, 0, 0, 0}; }
+
+void logf(const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+}
+
+bool startTask(TaskFunction fn, const char *, uint32_t, void *arg, int, int)
+{
+  std::thread(fn, arg).detach();
+  return true;
+}
+
+Mutex::Mutex() : handle(new std::timed_mutex()) {}
+Mutex::~Mutex() { delete (std::timed_mutex *)handle; }
+
+bool Mutex::take(uint32_t timeoutMs)
+{
+  std::timed_mutex *m = (std::timed_mutex *)handle;
+  if (timeoutMs == HAL_WAIT_FOREVER)
+  {
+    m->lock();
+    return true;
+  }
+  if (timeoutMs == 0)
+    return m->try_lock();
+  return m->try_lock_for(std::chrono::milliseconds(timeoutMs));
+}
+
+void Mutex::give() { ((std::timed_mutex *)handle)->unlock(); }
+
+struct QueueHandle {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<uint8_t> items;
+    size_t itemSize;
+    size_t length;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+// Waits on cv until ready() or timeout, HAL_WAIT_FOREVER waits without limit
+template <typename Ready>
+static bool waitFor(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, uint32_t timeoutMs, Ready ready)
+{
+  if (timeoutMs == HAL_WAIT_FOREVER)
+  {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+}
+
+#define QUEUE ((QueueHandle *)handle)
+
+Queue::Queue(size_t length, size_t itemSize) : handle(new QueueHandle())
+{
+  QUEUE->items.resize(length * itemSize);
+  QUEUE->itemSize = itemSize;
+  QUEUE->length = length;
+}
+
+Queue::~Queue() { delete QUEUE; }
+
+bool Queue::send(const void *item, uint32_t timeoutMs)
+{
+  QueueHandle *q = QUEUE;
+  std::unique_lock<std::mutex> lock(q->mutex);
+  if (!waitFor(q->changed, lock, timeoutMs, [q]
+               { return q->count < q->length; }))
+    return false;
+  memcpy(&q->items[((q->head + q->count) % q->length) * q->itemSize], item, q->itemSize);
+  q->count++;
+  q->changed.notify_all();
+  return true;
+}
+
+bool Queue::receive(void *item, uint32_t timeoutMs)
+{
+  QueueHandle *q = QUEUE;
+  std::unique_lock<std::mutex> lock(q->mutex);
+  if (!waitFor(q->changed, lock, timeoutMs, [q]
+               { return q->count > 0; }))
+    return false;
+  memcpy(item, &q->items[q->head * q->itemSize], q->itemSize);
+  q->head = (q->head + 1) % q->length;
+  q->count--;
+  q->changed.notify_all();
+  return true;
+}
+
+size_t Queue::count() const
+{
+  std::lock_guard<std::mutex> lock(QUEUE->mutex);
+  return QUEUE->count;
+}
+
+#undef QUEUE
+
+struct SignalHandle {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool set = false;
+};
+
+#define SIGNAL ((SignalHandle *)handle)
+
+Signal::Signal() : handle(new SignalHandle()) {}
+Signal::~Signal() { delete SIGNAL; }
+
+void Signal::give()
+{
+  std::lock_guard<std::mutex> lock(SIGNAL->mutex);
+  SIGNAL->set = true;
+  SIGNAL->cv.notify_one();
+}
+
+bool Signal::wait(uint32_t timeoutMs)
+{
+  SignalHandle *s = SIGNAL;
+  std::unique_lock<std::mutex> lock(s->mutex);
+  if (!waitFor(s->cv, lock, timeoutMs, [s]
+               { return s->set; }))
+    return false;
+  s->set = false;
+  return true;
+}
+
+#undef SIGNAL
+
+// --- NVS, namespace -> key -> raw bytes ---
+struct NvsHandle {
+    std::string ns;
+    bool open = false;
+    bool readOnly = true;
+};
+
+static std::mutex nvsMutex;
+static std::map<std::string, std::map<std::string, std::string>> nvsData;
+
+#define NVS ((NvsHandle *)handle)
+
+Nvs::Nvs() : handle(new NvsHandle()) {}
+Nvs::~Nvs() { delete NVS; }
+
+bool Nvs::begin(const char *ns, bool readOnly)
+{
+  NVS->ns = ns;
+  NVS->open = true;
+  NVS->readOnly = readOnly;
+  return true;
+}
+
+void Nvs::end() { NVS->open = false; }
+
+bool Nvs::isKey(const char *key)
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  return NVS->open && nvsData[NVS->ns].count(key) > 0;
+}
+
+bool Nvs::clear()
+{
+  if (!NVS->open || NVS->readOnly)
+    return false;
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  nvsData[NVS->ns].clear();
+  return true;
+}
+
+int32_t Nvs::getInt(const char *key, int32_t defaultValue)
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  auto &ns = nvsData[NVS->ns];
+  auto it = ns.find(key);
+  if (!NVS->open || it == ns.end() || it->second.size() != sizeof(int32_t))
+    return defaultValue;
+  int32_t value;
+  memcpy(&value, it->second.data(), sizeof(value));
+  return value;
+}
+
+bool Nvs::putInt(const char *key, int32_t value)
+{
+  if (!NVS->open || NVS->readOnly)
+    return false;
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  nvsData[NVS->ns][key] = std::string((const char *)&value, sizeof(value));
+  return true;
+}
+
+std::string Nvs::getString(const char *key, const char *defaultValue)
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  auto &ns = nvsData[NVS->ns];
+  auto it = ns.find(key);
+  if (!NVS->open || it == ns.end())
+    return defaultValue;
+  return it->second;
+}
+
+bool Nvs::putString(const char *key, const std::string &value)
+{
+  if (!NVS->open || NVS->readOnly)
+    return false;
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  nvsData[NVS->ns][key] = value;
+  return true;
+}
+
+size_t Nvs::getBytesLength(const char *key)
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  auto &ns = nvsData[NVS->ns];
+  auto it = ns.find(key);
+  return NVS->open && it != ns.end() ? it->second.size() : 0;
+}
+
+size_t Nvs::getBytes(const char *key, void *buf, size_t maxLen)
+{
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  auto &ns = nvsData[NVS->ns];
+  auto it = ns.find(key);
+  if (!NVS->open || it == ns.end() || it->second.size() > maxLen)
+    return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+bool Nvs::putBytes(const char *key, const void *buf, size_t len)
+{
+  return putString(key, std::string((const char *)buf, len));
+}
+
+bool Nvs::remove(const char *key)
+{
+  if (!NVS->open || NVS->readOnly)
+    return false;
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  return nvsData[NVS->ns].erase(key) > 0;
+}
+
+#undef NVS
+
+// --- Files ---
+static std::string hostPath(const char *path)
+{
+  const char *root = getenv("HAL_FS_ROOT");
+  return std::string(root ? root : "native_fs") + path;
+}
+
+bool fsMount()
+{
+  std::string root = hostPath("");
+  return mkdir(root.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool fsExists(const char *path) { return access(hostPath(path).c_str(), F_OK) == 0; }
+bool fsMkdir(const char *path) { return mkdir(hostPath(path).c_str(), 0755) == 0; }
+bool fsRemove(const char *path) { return unlink(hostPath(path).c_str()) == 0; }
+
+void fsList(const char *dir, const std::function<void(const char *name)> &fn)
+{
+  DIR *d = opendir(hostPath(dir).c_str());
+  if (!d)
+    return;
+  for (struct dirent *e = readdir(d); e; e = readdir(d))
+  {
+    if (e->d_type == DT_REG)
+      fn(e->d_name);
+  }
+  closedir(d);
+}
+
+File::File() : handle(nullptr) {}
+File::~File() { close(); }
+
+bool File::open(const char *path, const char *mode)
+{
+  close();
+  char m[4];
+  snprintf(m, sizeof(m), "%cb", mode[0]); // binary, same as LittleFS
+  handle = fopen(hostPath(path).c_str(), m);
+  return handle != nullptr;
+}
+
+void File::close()
+{
+  if (handle)
+    fclose((FILE *)handle);
+  handle = nullptr;
+}
+
+size_t File::read(void *buf, size_t len) { return handle ? fread(buf, 1, len, (FILE *)handle) : 0; }
+size_t File::write(const void *buf, size_t len) { return handle ? fwrite(buf, 1, len, (FILE *)handle) : 0; }
+bool File::seek(size_t pos) { return handle && fseek((FILE *)handle, (long)pos, SEEK_SET) == 0; }
+
+size_t File::size()
+{
+  struct stat st;
+  if (!handle || fflush((FILE *)handle) != 0 || fstat(fileno((FILE *)handle), &st) != 0)
+    return 0;
+  return st.st_size;
+}
+
+} // namespace hal
+#endif
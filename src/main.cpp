@@ -5,9 +5,17 @@
 #include <ArduinoJson.h>
 #include <time.h>
 #include "WiFiCredentials.h"
+#include "Calibration.h"
 #include "ConfigManager.h"
+#include "JsonArena.h"
 #include "LogManager.h"
 #include "ServerManager.h"
+#include "SensorManager.h"
+#include "SoilArchive.h"
+#include "SoilStats.h"
+#include "WateringManager.h"
+#include "Scheduler.h"
+#include "hal/Hal.h"
 
 // ===============================================================
 // ESP32 Uncle Sunduck Garden Controller
@@ -44,19 +52,23 @@ const int soilPins[4] = {10, 9, 11, 3};
 
 // Last readed soil humidity values
 uint16_t soilReadingsLast[4] = {0, 0, 0, 0};
-// Minimal readings of soil humidity, most wet value
-uint16_t soilReadingsMin[4] = {4095, 4095, 4095, 4095};
-// Maximal readings of soil humidity, most dry value
-uint16_t soilReadingsMax[4] = {0, 0, 0, 0};
+// Per light cycle statistics of soil readings (min is the most wet, max the most dry value)
+SoilStats soilStats;
+// One file of soil readings per past day, written by the scheduler task
+SoilArchive archive;
 
 AsyncWebServer server(80);
 ConfigManager config;
 LogManager logManager;
-volatile bool pumpActive = false; // guard: only one watering at a time
+JsonPool jsonPool;
+SensorManager sensors(relay5vPins, soilPins);
+WateringManager watering(relay12vPins, PUMP_RELAY_PIN);
+Scheduler scheduler;
+volatile bool pumpActive = false; // watering job running or queued, soil sweeps are skipped
 
 String getTimestamp()
 {
-  time_t now = time(nullptr);
+  time_t now = hal::now();
   struct tm timeinfo;
   localtime_r(&now, &timeinfo);
   char buf[25];
@@ -122,186 +134,13 @@ void setupNTP()
   logDebug("NTP sync successful, timestamped logging enabled");
 }
 
-void readSoilSensor(int sensorId)
-{
-  // powering up 5V sensor (active LOW)
-  digitalWrite(relay5vPins[sensorId], LOW);
-  // dalying to let sensor settle after powering up
-  delay(config.sensorSettleTime);
-
-  long sum = 0;
-  for (int j = 0; j < config.soilSensorCounter; j++)
-  {
-    // reading sensor multiple times and averaging
-    sum += analogRead(soilPins[sensorId]);
-    delay(50);
-  }
-  int value = sum / config.soilSensorCounter;
-  soilReadingsLast[sensorId] = value;
-  if (value < soilReadingsMin[sensorId])
-    soilReadingsMin[sensorId] = value;
-  if (value > soilReadingsMax[sensorId])
-    soilReadingsMax[sensorId] = value;
-  logManager.addSoilEvent(sensorId, value);
-  // powering down 5V sensor
-  digitalWrite(relay5vPins[sensorId], HIGH); // powering sensor off
-}
-
 // --- Soil sensors ---
-void readSoilSensors()
-{
-  // skipping soil read if watering is active
-  // to prevent false readings due to water in soil
-  // also to prevent power supply dips
-  if (pumpActive)
-  {
-    logDebug("Pump active, skipping soil sensor read");
-    return;
-  }
-  for (int i = 0; i < 4; i++)
-  {
-    readSoilSensor(i);
-  }
-}
-
-/*
-// Task scheduling soil moisture readings
-// during light cycle only (to prevent corrosion of soil sensors)
-// pinned to core 1 (not using WiFi functions)
-// uses config values:
-// lightStart - start of the light cycle (it could start at night if you have night energy tatiffs)
-// lightEnd - end of the light cycle, it defines soil moisture logging period
-// soilLogIntervalMin - interval in minutes to log soil data (e.g. int(15) is for every 15th minute of the hour, starting with 0 minute)
-*/
-
-void soilTask(void *pvParameters)
+// Full sweep on the acquisition task, skipped while watering.
+// Runs from the scheduler task, so it only queues the sweep and never waits on it.
+void requestSoilSweep()
 {
-  static int LogResetDay = -1;
-
-  for (;;)
-  {
-    time_t now = time(nullptr);
-    struct tm timeinfo;
-    localtime_r(&now, &timeinfo);
-
-    int startHour = (config.lightStart - 1 + 24) % 24; // start one hour earlier
-    int endHour = config.lightEnd;
-
-    bool inLightCycle;
-    if (startHour < endHour)
-    {
-      inLightCycle = (timeinfo.tm_hour >= startHour && timeinfo.tm_hour < endHour);
-    }
-    else
-    {
-      inLightCycle = (timeinfo.tm_hour >= startHour || timeinfo.tm_hour < endHour);
-    }
-
-    if (inLightCycle && (config.soilLogIntervalMin > 0) && (timeinfo.tm_min % config.soilLogIntervalMin == 0))
-    {
-      readSoilSensors();
-      vTaskDelay(60000 / portTICK_PERIOD_MS); // avoid duplicate logs within same minute
-    }
-
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-  }
-}
-
-void wateringCycle(int duration0, int duration1, int duration2, int duration3)
-{
-
-  if (pumpActive)
-  {
-    logDebug("Pump already active, rejecting watering request");
-    return;
-  }
-
-  pumpActive = true;
-
-  // Local fixed-size array — lives on the stack, fast and safe
-  int* durations = new int[4];
-  durations[0] = duration0;
-  durations[1] = duration1;
-  durations[2] = duration2;
-  durations[3] = duration3;
-
-  // Create a task; pass the array by *value* (copied into task stack)
-  BaseType_t result = xTaskCreatePinnedToCore(
-      [](void *param)
-      {
-        int* durations = (int*)param;
-        for (int i = 0; i < 4; i++)
-        {
-          int seconds = durations[i];
-          if (seconds > 0)
-          {
-            //logDebug("Starting watering cycle for valve " + String(i) + " for " + String(seconds) + " seconds");
-            // reading soil sensor before watering
-            readSoilSensor(i);
-
-            digitalWrite(relay12vPins[i], HIGH); // Valve ON (active HIGH)
-            digitalWrite(PUMP_RELAY_PIN, LOW);   // Pump ON (active LOW)
-
-            // Wait valve duration + 3s buffer
-            vTaskDelay((seconds + 3) * 1000 / portTICK_PERIOD_MS);
-
-            digitalWrite(PUMP_RELAY_PIN, HIGH); // Pump OFF
-            digitalWrite(relay12vPins[i], LOW); // Valve OFF
-
-            //logDebug("Watering cycle for valve " + String(i) + " completed");
-
-            logManager.addWaterEvent(i, seconds);
-
-            // Wait 3 seconds before next valve
-            vTaskDelay(3000 / portTICK_PERIOD_MS);
-          }
-        }
-        delete[] durations; // Free memory after use
-        pumpActive = false;
-        vTaskDelete(NULL); // End task safely
-      },
-      "WCycleTask", // Task name
-      4096,         // Stack size (bytes)
-      durations,    // Parameter (copied in)
-      1,            // Priority
-      NULL,         // Task handle
-      1             // Core (optional)
-  );
-  if (result != pdPASS)
-  {
-    logDebug("Failed to create WCycleTask!");
-    ESP.restart();
-  }
-}
-
-void wateringSchedulerTask(void *pvParameters)
-{
-  int lastMinute = -1;
-  TickType_t lastWake = xTaskGetTickCount();
-
-  for (;;)
-  {
-    time_t now = time(nullptr);
-    struct tm timeinfo;
-    localtime_r(&now, &timeinfo);
-
-    if (timeinfo.tm_min != lastMinute)
-    {
-      lastMinute = timeinfo.tm_min;
-
-      char buf[6];
-      strftime(buf, sizeof(buf), "%H:%M", &timeinfo);
-
-      for (const auto &sched : config.wateringSchedules)
-      {
-        if (sched.time == String(buf))
-        {
-          wateringCycle(sched.durations[0], sched.durations[1], sched.durations[2], sched.durations[3]);
-        }
-      }
-    }
-    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(1000));
-  }
+  if (!sensors.requestSweep())
+    logDebug("Sensor queue full, soil sweep skipped");
 }
 
 // --- Setup + loop ---
@@ -314,55 +153,90 @@ void setup()
 
   for (int i = 0; i < 8; i++)
   {
-    pinMode(relay5vPins[i], OUTPUT);
-    digitalWrite(relay5vPins[i], HIGH); // default OFF (active LOW)
+    hal::pinOutput(relay5vPins[i]);
+    hal::pinWrite(relay5vPins[i], true); // default OFF (active LOW)
   }
   Serial0.println("[DEBUG] 5V relays initialized (default OFF, active LOW)");
 
   for (int i = 0; i < 4; i++)
   {
-    pinMode(relay12vPins[i], OUTPUT);
-    digitalWrite(relay12vPins[i], LOW); // default OFF (active HIGH)
+    hal::pinOutput(relay12vPins[i]);
+    hal::pinWrite(relay12vPins[i], false); // default OFF (active HIGH)
   }
   Serial0.println("[DEBUG] 12V relays initialized (default OFF, active HIGH)");
 
   for (int i = 0; i < 4; i++)
-    pinMode(soilPins[i], INPUT);
+    hal::pinInput(soilPins[i]);
   Serial0.println("[DEBUG] Soil sensor pins set as INPUT");
 
   setupWiFi();
   setupNTP();
 
+  // event storage goes to PSRAM, journal replay needs timezone for daily rollups
+  logManager.begin();
+  // daily archive files on the same filesystem, mounted by the journal
+  if (!archive.begin())
+    logDebug("Soil archive unavailable");
+  // handler JSON memory, reserved once before the heap gets fragmented
+  if (!jsonPool.begin())
+    logDebug("JsonPool allocation failed, handlers use the heap");
+
   config.load();
+  ConfigData cfg = *config.get();
+  if (cfg.soilLogIntervalMin <= 0 || cfg.soilSensorCounter <= 0)
+  {
+    if (cfg.soilLogIntervalMin <= 0)
+      cfg.soilLogIntervalMin = 15; // safety default
+    if (cfg.soilSensorCounter <= 0)
+      cfg.soilSensorCounter = 50; // safety default
+    config.publish(cfg);
+  }
 
-  // Register routes (ServerManager.cpp)
-  setupServer();
+  // valve flow rates turn volume targets into open times and decide which valves may overlap;
+  // read without a lock, so set before the scheduler or POST /watering can plan a job
+  FlowCalibration calibration;
+  loadCalibration(CALIBRATION_PATH, calibration);
+  watering.setCalibration(calibration);
 
-  // Start web server after all modules had chance to register endpoints
-  server.begin();
-  logDebug("Web server started");
-
-  if (config.soilLogIntervalMin <= 0)
-    config.soilLogIntervalMin = 15; // safety default
+  // Register routes (ServerManager.cpp), before any task produces log events
+  setupServer();
 
-  if (config.soilSensorCounter <= 0)
-    config.soilSensorCounter = 50; // safety default
+  // Start sensor acquisition task (pinned to core 1), owns sensor relays and ADC
+  if (!sensors.begin())
+  {
+    logDebug("Failed to create SensorTask!");
+    logManager.sync(true);
+    ESP.restart();
+  }
 
-  // Start soil humidity sensors logging task (pinned to core 1)
-  BaseType_t result = xTaskCreatePinnedToCore(soilTask, "SoilTask", 4096, NULL, 1, NULL, 1);
-  if (result != pdPASS)
+  // Start watering worker (pinned to core 1), owns pump and valve relays
+  watering.setValveHook([](uint8_t valves)
+                        { sensors.read(valves, false); }); // reading soil sensors before watering
+  watering.setActiveListener([](bool active)
+                             {
+                               pumpActive = active;
+                               publishPumpState(active); });
+  if (!watering.begin())
   {
-    logDebug("Failed to create SoilTask!");
+    logDebug("Failed to create WateringTask!");
+    logManager.sync(true);
     ESP.restart();
   }
 
-  // Start watering scheduler task (pinned to core 1)
-  result = xTaskCreatePinnedToCore(wateringSchedulerTask, "WSchedulerTask", 4096, NULL, 1, NULL, 1);
-  if (result != pdPASS)
+  // Start scheduler task (pinned to core 1): soil logging during light cycle,
+  // watering schedules and periodic journal flushes
+  scheduler.setSoilHook(requestSoilSweep);
+  if (!scheduler.begin())
   {
-    logDebug("Failed to create WSchedulerTask!");
+    logDebug("Failed to create SchedulerTask!");
+    logManager.sync(true);
     ESP.restart();
   }
+
+  // Accept connections only once every module registered its endpoints and
+  // the tasks behind them are running
+  server.begin();
+  logDebug("Web server started");
 }
 
 void loop()
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <ArduinoJson.h>
+#include "../ConfigManager.h"
+#include "../JsonArena.h"
+#include "../LogManager.h"
+#include "../LogStreamer.h"
+#include "../Metrics.h"
+#include "../SoilStats.h"
+#include "../hal/Hal.h"
+
+// ===============================================================
+// Micro-benchmarks of the hot paths, env:bench
+//
+//   pio run -e bench && .pio/build/bench/program > bench.jsonl
+//
+// One JSON object per line on stdout (HAL logging goes to stderr):
+//   {"name":..., "ops":N, "ns_per_op":..., "allocs_per_op":..., "alloc_bytes_per_op":...}
+// Allocations are counted by wrapping malloc/realloc/calloc (glibc), which
+// covers operator new and ArduinoJson's default allocator.
+// ===============================================================
+
+static std::atomic<bool> counting(false);
+static std::atomic<uint64_t> allocCount(0);
+static std::atomic<uint64_t> allocBytes(0);
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+
+static inline void countAlloc(size_t size)
+{
+  if (counting.load(std::memory_order_relaxed))
+  {
+    allocCount++;
+    allocBytes += size;
+  }
+}
+
+extern "C" void *malloc(size_t size)
+{
+  countAlloc(size);
+  return __libc_malloc(size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  countAlloc(size);
+  return __libc_realloc(ptr, size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+  countAlloc(n * size);
+  return __libc_calloc(n, size);
+}
+#endif
+
+ConfigManager config;
+LogManager logManager;
+JsonPool jsonPool;
+
+// Runs op(i) for i in [0, ops) and prints one result line
+template <typename Op>
+static void bench(const char *name, size_t ops, Op op)
+{
+  allocCount = 0;
+  allocBytes = 0;
+  counting = true;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < ops; i++)
+    op(i);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  counting = false;
+
+  double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+  printf("{\"name\":\"%s\",\"ops\":%u,\"ns_per_op\":%.1f,\"allocs_per_op\":%.3f,\"alloc_bytes_per_op\":%.1f}\n",
+         name, (unsigned)ops, ns / ops, (double)allocCount / ops, (double)allocBytes / ops);
+  fflush(stdout);
+}
+
+// Refills the log with n soil readings, 15 minutes apart
+static void fillLog(size_t n)
+{
+  logManager.clear();
+  for (size_t i = 0; i < n; i++)
+  {
+    logManager.addSoilEvent(i % 4, 2000 + (i * 7) % 300);
+    if (i % 4 == 3)
+      hal::advanceClock(15 * 60);
+  }
+}
+
+static volatile size_t sink; // keeps results alive
+
+// A /status sized document, serialized the way handlers do
+static size_t buildStatus(JsonDocument &doc, uint8_t *out, size_t outLen)
+{
+  ConfigRef cfg = config.get();
+  doc["wifi"] = "GardenNet";
+  doc["ip"] = "192.168.1.125";
+  doc["mode"] = cfg->mode;
+  doc["lightStart"] = cfg->lightStart;
+  doc["lightEnd"] = cfg->lightEnd;
+  JsonArray soil = doc["soilHumidityLast"].to<JsonArray>();
+  for (int i = 0; i < 4; i++)
+    soil.add(2000 + i);
+  JsonArray schedules = doc["wateringSchedules"].to<JsonArray>();
+  for (const WateringSchedule &ws : cfg->wateringSchedules)
+  {
+    JsonObject obj = schedules.add<JsonObject>();
+    obj["time"] = ws.time;
+    JsonArray d = obj["durations"].to<JsonArray>();
+    for (int v = 0; v < 4; v++)
+      d.add(ws.durations[v]);
+  }
+  doc["uptime"] = std::string("1d 17h 1m 37s");
+  return serializeJson(doc, out, outLen);
+}
+
+int main()
+{
+  logManager.begin();
+  config.load();
+
+  // --- LogManager ---
+  logManager.clear();
+  bench("log_push", 200000, [](size_t i)
+        {
+          logManager.addSoilEvent(i % 4, 2000 + i % 300);
+          if (i % 4 == 3)
+            hal::advanceClock(15 * 60); });
+
+  {
+    uint32_t first, end;
+    logManager.getSeqRange(first, end);
+    size_t events = end - first;
+    uint32_t cursor = first;
+    Event batch[16];
+    size_t left = 0;
+    // one op = one event, read in the same 16 event batches as LogStreamer
+    bench("log_read", events, [&](size_t)
+          {
+            if (left == 0)
+            {
+              left = logManager.readEvents(cursor, batch, 16);
+              if (left == 0)
+              {
+                cursor = first;
+                left = logManager.readEvents(cursor, batch, 16);
+              }
+            }
+            left--;
+            sink = batch[left].value; });
+  }
+
+  // --- full /logs bodies by log size, one op = one request ---
+  static const size_t sizes[] = {100, 1000, 10000, 50000};
+  static const struct
+  {
+    response_format_t format;
+    const char *name;
+  } formats[] = {{FORMAT_JSON, "json"}, {FORMAT_CSV, "csv"}, {FORMAT_MSGPACK, "msgpack"}};
+  for (size_t n : sizes)
+  {
+    fillLog(n);
+    for (const auto &f : formats)
+    {
+      char name[32];
+      snprintf(name, sizeof(name), "logs_%s_%u", f.name, (unsigned)n);
+      size_t requests = n >= 10000 ? 5 : 50;
+      bench(name, requests, [&](size_t)
+            {
+              uint8_t chunk[1024]; // typical TCP window share of a chunked response
+              LogStreamer streamer(logManager, LogQuery(), f.format);
+              size_t total = 0;
+              for (size_t len; (len = streamer.fill(chunk, sizeof(chunk))) > 0;)
+                total += len;
+              sink = total; });
+    }
+  }
+
+  // --- ConfigManager binary config through NVS (unchanged, so no writes) ---
+  bench("config_roundtrip", 2000, [](size_t)
+        {
+          config.save();
+          config.load(); });
+
+  // --- handler JSON documents, general heap vs pooled arena ---
+  jsonPool.begin();
+  bench("json_doc_heap", 20000, [](size_t)
+        {
+          uint8_t out[512];
+          JsonDocument doc;
+          sink = buildStatus(doc, out, sizeof(out)); });
+  bench("json_doc_arena", 20000, [](size_t)
+        {
+          JsonBuffer out(512);
+          JsonArena arena;
+          JsonDocument doc(&arena);
+          sink = buildStatus(doc, out.data(), out.capacity()); });
+
+  // --- instrumentation cost, paid on every lock and every request ---
+  {
+    hal::Mutex mutex;
+    bench("mutex_lock_unlock", 1000000, [&](size_t)
+          {
+            mutex.lock();
+            mutex.unlock(); });
+    static Metrics metrics;
+    int route = metrics.addRoute("GET", "/status");
+    bench("metrics_observe", 1000000, [&](size_t i)
+          { metrics.observe(route, (uint32_t)(i * 37) % 300000); });
+  }
+
+  // --- soil statistics, once per reading ---
+  {
+    static SoilStats stats;
+    time_t start = hal::now();
+    bench("soil_stats_add", 200000, [&](size_t i)
+          { stats.add(i % SOIL_STATS_SENSORS, start + i * 60, 2000 + i % 300, 23, 17); });
+  }
+
+  // --- timestamp formatting, once per rendered event ---
+  time_t base = hal::now();
+  bench("timestamp_strftime", 200000, [&](size_t i)
+        {
+          char ts[25];
+          time_t t = base + i * 60;
+          struct tm timeinfo;
+          localtime_r(&t, &timeinfo);
+          strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &timeinfo);
+          sink = ts[18]; });
+  {
+    TimestampFormatter timestamps;
+    bench("timestamp_format", 200000, [&](size_t i)
+          {
+            char ts[TIMESTAMP_LEN + 1];
+            timestamps.format(ts, base + i * 60);
+            sink = ts[18]; });
+  }
+
+  // --- /logs with epoch timestamps ---
+  fillLog(10000);
+  bench("logs_json_epoch_10000", 5, [](size_t)
+        {
+          uint8_t chunk[1024];
+          LogQuery query;
+          query.epochTimestamps = true;
+          LogStreamer streamer(logManager, query, FORMAT_JSON);
+          size_t total = 0;
+          for (size_t len; (len = streamer.fill(chunk, sizeof(chunk))) > 0;)
+            total += len;
+          sink = total; });
+
+  return 0;
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../ConfigManager.h"
+#include "../JsonArena.h"
+#include "../LogManager.h"
+#include "../LogStreamer.h"
+#include "../SoilArchive.h"
+#include "../SoilStats.h"
+#include "../hal/Hal.h"
+
+// ===============================================================
+// Host driver for env:native
+//
+// Runs the controller logic (config, event log, journal, /logs rendering)
+// on Linux against a simulated clock, so hot paths can be measured with
+// perf, valgrind or heaptrack instead of guessed from the serial port:
+//
+//   pio run -e native
+//   perf record -g .pio/build/native/program 90
+//
+// Argument is the number of simulated days (default 30). Soil readings are
+// generated every config.soilLogIntervalMin minutes during the light cycle,
+// watering events at the configured schedule times.
+// Journal and archive files go to $HAL_FS_ROOT (default ./native_fs).
+// ===============================================================
+
+ConfigManager config;
+LogManager logManager;
+JsonPool jsonPool;
+SoilStats soilStats;
+SoilArchive archive;
+
+static bool inLightCycle(const ConfigData &cfg, int hour)
+{
+  int startHour = (cfg.lightStart - 1 + 24) % 24; // same window as the scheduler
+  int endHour = cfg.lightEnd;
+  if (startHour < endHour)
+    return hour >= startHour && hour < endHour;
+  return hour >= startHour || hour < endHour;
+}
+
+// Returns simulated seconds
+static uint32_t simulate(int days)
+{
+  uint16_t moisture[4] = {1800, 2000, 2200, 2400};
+  ConfigRef cfg = config.get();
+  int stepMin = cfg->soilLogIntervalMin > 0 ? cfg->soilLogIntervalMin : 15;
+  int steps = days * 24 * 60 / stepMin;
+
+  for (int s = 0; s < steps; s++)
+  {
+    time_t now = hal::now();
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+
+    if (inLightCycle(*cfg, timeinfo.tm_hour))
+    {
+      for (int i = 0; i < 4; i++)
+      {
+        moisture[i] += rand() % 9; // soil dries out slowly
+        logManager.addSoilEvent(i, moisture[i]);
+        soilStats.add(i, now, moisture[i], cfg->lightStart, cfg->lightEnd);
+      }
+    }
+
+    char buf[6];
+    snprintf(buf, sizeof(buf), "%02d:%02d", timeinfo.tm_hour, timeinfo.tm_min);
+    for (const auto &sched : cfg->wateringSchedules)
+    {
+      if (sched.time != buf)
+        continue;
+      for (int i = 0; i < 4; i++)
+      {
+        if (sched.durations[i] <= 0)
+          continue;
+        logManager.addWaterEvent(i, sched.durations[i]);
+        moisture[i] -= sched.durations[i] * 8;
+      }
+    }
+
+    logManager.sync();
+    archive.rollover(logManager, now);
+    hal::advanceClock(stepMin * 60);
+  }
+  logManager.sync(true);
+  return (uint32_t)steps * stepMin * 60;
+}
+
+static void streamLogs(response_format_t format, const char *name)
+{
+  uint8_t chunk[1024];
+  uint64_t start = hal::uptimeUs();
+  LogStreamer streamer(logManager, LogQuery(), format);
+  size_t total = 0, chunks = 0;
+  for (size_t n; (n = streamer.fill(chunk, sizeof(chunk))) > 0; total += n)
+    chunks++;
+  uint64_t elapsed = hal::uptimeUs() - start;
+  hal::logf("[Native] /logs %-7s %8u bytes in %4u chunks, %6u us\n", name, (unsigned)total, (unsigned)chunks, (unsigned)elapsed);
+}
+
+#ifndef PIO_UNIT_TESTING
+int main(int argc, char **argv)
+{
+  int days = argc > 1 ? atoi(argv[1]) : 30;
+  srand(1);
+
+  config.load();
+  ConfigData cfg = *config.get();
+  cfg.setDefaultSchedules();
+  config.publish(cfg);
+  config.save();
+  logManager.begin();
+  archive.begin();
+
+  // align simulated clock to local midnight, the schedule is matched on whole minutes
+  time_t now = hal::now();
+  struct tm timeinfo;
+  localtime_r(&now, &timeinfo);
+  hal::advanceClock(((24 - timeinfo.tm_hour) * 60 - timeinfo.tm_min) * 60 - timeinfo.tm_sec);
+
+  uint64_t start = hal::uptimeUs();
+  uint32_t simulated = simulate(days);
+  uint64_t elapsed = hal::uptimeUs() - start - (uint64_t)simulated * 1000000;
+  hal::logf("[Native] Simulated %d days: %d events in log, %u us\n", days, logManager.getEventCount(), (unsigned)elapsed);
+
+  SoilCycle current, previous;
+  ConfigRef cfgNow = config.get();
+  if (soilStats.snapshot(hal::now(), cfgNow->lightStart, cfgNow->lightEnd, current, previous))
+  {
+    for (int i = 0; i < SOIL_STATS_SENSORS; i++)
+    {
+      const SoilSummary &s = previous.sensors[i];
+      hal::logf("[Native] Last %s cycle, sensor %d: %u readings, %u..%u, mean %.1f sd %.1f ewma %.1f slope %.2f/h\n",
+                previous.light ? "light" : "dark", i, (unsigned)s.count, s.min, s.max, s.mean, s.stddev, s.ewma, s.slope);
+    }
+  }
+
+  std::vector<std::string> archived = archive.list();
+  if (!archived.empty())
+  {
+    char path[48];
+    snprintf(path, sizeof(path), "%s/%s", ARCHIVE_DIR, archived.front().c_str());
+    uint8_t chunk[1024];
+    uint64_t t0 = hal::uptimeUs();
+    ArchiveStreamer streamer;
+    size_t total = 0;
+    if (streamer.open(path))
+      for (size_t n; (n = streamer.fill(chunk, sizeof(chunk))) > 0;)
+        total += n;
+    hal::logf("[Native] Archive: %u days, %s as JSON %u bytes, %u us\n", (unsigned)archived.size(), archived.front().c_str(),
+              (unsigned)total, (unsigned)(hal::uptimeUs() - t0));
+  }
+
+  streamLogs(FORMAT_JSON, "json");
+  streamLogs(FORMAT_CSV, "csv");
+  streamLogs(FORMAT_MSGPACK, "msgpack");
+  return 0;
+}
+#endif
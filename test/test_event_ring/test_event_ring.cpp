@@ -0,0 +1,118 @@
+// Host stress test of the lock-free staging ring: pio test -e native
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "EventRing.h"
+
+#define PRODUCERS 8
+#define EVENTS_PER_PRODUCER 200000
+
+// Every field derives from (producer, seq), so a payload mixed from two pushes is detected
+static Event makeEvent(uint32_t producer, uint32_t seq)
+{
+    Event event;
+    event.timestamp = (producer << 24) | seq;
+    event.eventType = (event_type_t)(1 + producer % (EVENT_TYPE_COUNT - 1));
+    event.value = (uint16_t)(seq * 2654435761u >> 16);
+    return event;
+}
+
+static bool splitEvent(const Event &event, uint32_t &producer, uint32_t &seq)
+{
+    producer = (uint32_t)event.timestamp >> 24;
+    seq = (uint32_t)event.timestamp & 0xFFFFFF;
+    if (producer >= PRODUCERS || seq >= EVENTS_PER_PRODUCER)
+        return false;
+    Event expected = makeEvent(producer, seq);
+    return event.eventType == expected.eventType && event.value == expected.value;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_lapped_positions_are_counted()
+{
+    EventRing ring;
+    for (uint32_t i = 0; i < 100; i++)
+        ring.push(makeEvent(0, i));
+
+    std::vector<uint32_t> seen;
+    size_t delivered = ring.drain([&](const Event &event)
+                                  { seen.push_back((uint32_t)event.timestamp); });
+
+    TEST_ASSERT_EQUAL_UINT32(LOG_STAGING_SLOTS, delivered);
+    TEST_ASSERT_EQUAL_UINT32(100 - LOG_STAGING_SLOTS, ring.droppedCount());
+    TEST_ASSERT_EQUAL_UINT32(100, ring.pushedCount());
+    for (size_t i = 0; i < seen.size(); i++)
+        TEST_ASSERT_EQUAL_UINT32(100 - LOG_STAGING_SLOTS + i, seen[i]);
+
+    ring.push(makeEvent(0, 100));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.drain([](const Event &) {}));
+    TEST_ASSERT_EQUAL_UINT32(100 - LOG_STAGING_SLOTS, ring.droppedCount());
+}
+
+static void test_concurrent_producers()
+{
+    static EventRing ring;
+    std::atomic<int> running(PRODUCERS);
+    uint32_t lastSeq[PRODUCERS];
+    for (uint32_t &seq : lastSeq)
+        seq = UINT32_MAX;
+    size_t delivered = 0, torn = 0, reordered = 0;
+
+    auto sink = [&](const Event &event)
+    {
+        uint32_t producer, seq;
+        if (!splitEvent(event, producer, seq))
+        {
+            torn++;
+            return;
+        }
+        // one producer's positions are increasing, so anything else is a duplicate or out of order
+        if (lastSeq[producer] != UINT32_MAX && seq <= lastSeq[producer])
+            reordered++;
+        lastSeq[producer] = seq;
+        delivered++;
+    };
+
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < PRODUCERS; p++)
+        producers.emplace_back([&, p]()
+                               {
+            for (uint32_t seq = 0; seq < EVENTS_PER_PRODUCER; seq++)
+            {
+                ring.push(makeEvent(p, seq));
+                if ((seq & 0x3FF) == 0)
+                    std::this_thread::yield(); // let other producers lap this one now and then
+            }
+            running--; });
+
+    // consumer runs on this thread, yielding so producers keep lapping it
+    uint32_t rounds = 0;
+    while (running.load() > 0)
+    {
+        ring.drain(sink);
+        if (++rounds % 4)
+            std::this_thread::yield();
+    }
+    for (std::thread &t : producers)
+        t.join();
+    ring.drain(sink);
+
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, reordered);
+    TEST_ASSERT_EQUAL_UINT32(PRODUCERS * EVENTS_PER_PRODUCER, ring.pushedCount());
+    // every position is either delivered or dropped, exactly once
+    TEST_ASSERT_EQUAL_UINT32(ring.pushedCount(), delivered + ring.droppedCount());
+    TEST_ASSERT_TRUE(delivered > 0);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.drain(sink));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lapped_positions_are_counted);
+    RUN_TEST(test_concurrent_producers);
+    return UNITY_END();
+}
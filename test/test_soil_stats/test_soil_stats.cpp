@@ -0,0 +1,100 @@
+// Light cycle rollover of the soil statistics: pio test -e native
+#include <unity.h>
+#include <stdlib.h>
+#include <time.h>
+#include "SoilStats.h"
+
+#define LIGHT_START 6
+#define LIGHT_END 22
+#define DAY0 1759536000u // 2025-10-04 00:00 UTC
+#define HOUR 3600u
+
+// The Scheduler's soil logging window: the hour before lights on up to lights off
+static void logDay(SoilStats &stats, uint32_t day, uint16_t value)
+{
+    for (uint32_t t = day + (LIGHT_START - 1) * HOUR; t < day + LIGHT_END * HOUR; t += 15 * 60)
+        for (uint8_t i = 0; i < SOIL_STATS_SENSORS; i++)
+            stats.add(i, t, value, LIGHT_START, LIGHT_END);
+}
+
+void setUp()
+{
+    setenv("TZ", "UTC0", 1);
+    tzset();
+}
+void tearDown() {}
+
+static void test_no_previous_before_a_light_cycle()
+{
+    SoilStats stats;
+    SoilCycle current, previous;
+    // pre-dawn readings only, the dark phase finishes but is not a cycle
+    stats.add(0, DAY0 + 5 * HOUR, 2000, LIGHT_START, LIGHT_END);
+    TEST_ASSERT_FALSE(stats.snapshot(DAY0 + 7 * HOUR, LIGHT_START, LIGHT_END, current, previous));
+    TEST_ASSERT_TRUE(current.light);
+    TEST_ASSERT_EQUAL_UINT32(DAY0 + LIGHT_START * HOUR, current.start);
+    TEST_ASSERT_EQUAL_UINT32(0, current.sensors[0].count);
+}
+
+static void test_light_cycle_becomes_previous_at_lights_off()
+{
+    SoilStats stats;
+    SoilCycle current, previous;
+    logDay(stats, DAY0, 2000);
+    TEST_ASSERT_TRUE(stats.snapshot(DAY0 + 23 * HOUR, LIGHT_START, LIGHT_END, current, previous));
+    TEST_ASSERT_FALSE(current.light);
+    TEST_ASSERT_EQUAL_UINT32(DAY0 + LIGHT_END * HOUR, current.start);
+    TEST_ASSERT_TRUE(previous.light);
+    TEST_ASSERT_EQUAL_UINT32(DAY0 + LIGHT_START * HOUR, previous.start);
+    TEST_ASSERT_EQUAL_UINT32(DAY0 + LIGHT_END * HOUR, previous.end);
+    // 16 light hours, 4 readings an hour
+    TEST_ASSERT_EQUAL_UINT32(64, previous.sensors[0].count);
+    TEST_ASSERT_EQUAL_UINT16(2000, previous.sensors[3].last);
+}
+
+static void test_dark_phase_with_readings_keeps_light_cycle()
+{
+    SoilStats stats;
+    SoilCycle current, previous;
+    logDay(stats, DAY0, 2000);
+    // pre-dawn hour of the next day lands in the dark phase started at lights off
+    for (uint32_t t = DAY0 + 29 * HOUR; t < DAY0 + 30 * HOUR; t += 15 * 60)
+        stats.add(1, t, 2500, LIGHT_START, LIGHT_END);
+
+    TEST_ASSERT_TRUE(stats.snapshot(DAY0 + 29 * HOUR + 1800, LIGHT_START, LIGHT_END, current, previous));
+    TEST_ASSERT_FALSE(current.light);
+    TEST_ASSERT_EQUAL_UINT32(4, current.sensors[1].count);
+    TEST_ASSERT_EQUAL_UINT16(2500, current.sensors[1].last);
+
+    // after lights on the previous cycle is still the whole light phase, not the pre-dawn hour
+    TEST_ASSERT_TRUE(stats.snapshot(DAY0 + 30 * HOUR + 600, LIGHT_START, LIGHT_END, current, previous));
+    TEST_ASSERT_TRUE(current.light);
+    TEST_ASSERT_EQUAL_UINT32(DAY0 + 30 * HOUR, current.start);
+    TEST_ASSERT_TRUE(previous.light);
+    TEST_ASSERT_EQUAL_UINT32(DAY0 + LIGHT_START * HOUR, previous.start);
+    TEST_ASSERT_EQUAL_UINT32(DAY0 + LIGHT_END * HOUR, previous.end);
+    TEST_ASSERT_EQUAL_UINT32(64, previous.sensors[1].count);
+    TEST_ASSERT_EQUAL_UINT16(2000, previous.sensors[1].max);
+}
+
+static void test_next_light_cycle_replaces_previous()
+{
+    SoilStats stats;
+    SoilCycle current, previous;
+    logDay(stats, DAY0, 2000);
+    logDay(stats, DAY0 + 24 * HOUR, 2200);
+    TEST_ASSERT_TRUE(stats.snapshot(DAY0 + 47 * HOUR, LIGHT_START, LIGHT_END, current, previous));
+    TEST_ASSERT_EQUAL_UINT32(DAY0 + 30 * HOUR, previous.start);
+    TEST_ASSERT_EQUAL_UINT32(64, previous.sensors[2].count);
+    TEST_ASSERT_EQUAL_UINT16(2200, previous.sensors[2].min);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_no_previous_before_a_light_cycle);
+    RUN_TEST(test_light_cycle_becomes_previous_at_lights_off);
+    RUN_TEST(test_dark_phase_with_readings_keeps_light_cycle);
+    RUN_TEST(test_next_light_cycle_replaces_previous);
+    return UNITY_END();
+}
@@ -0,0 +1,150 @@
+// Dashboard for the garden controller, talks to the REST API of the same host.
+// /status is polled (its ETag turns most polls into 304), /events pushes log
+// events and pump state, /sensors/rollup feeds the chart.
+'use strict';
+
+const SENSORS = 4;
+const COLORS = ['#3f8f4a', '#2f6fb0', '#c0862b', '#a34a3a'];
+const MAX_EVENTS = 50;
+
+const $ = (sel) => document.querySelector(sel);
+
+async function getJson(url, options) {
+  const res = await fetch(url, options);
+  const body = await res.json().catch(() => ({}));
+  if (!res.ok)
+    throw new Error(body.error || res.statusText);
+  return body;
+}
+
+function renderStatus(s) {
+  const rows = [
+    ['Mode', s.mode],
+    ['Light', `${s.lightStart}:00 - ${s.lightEnd}:00`],
+    ['Pump', s.pumpActive ? 'on' : 'off'],
+    ['Last reading', s.lastReadingTimestamp],
+    ['Uptime', s.uptime],
+    ['WiFi', `${s.wifi} (${s.ip})`],
+    ['Free heap', `${Math.round(s.freeHeap / 1024)} KB`],
+  ];
+  $('#status').innerHTML = rows.map(([k, v]) => `<dt>${k}</dt><dd>${v}</dd>`).join('');
+
+  let html = '';
+  for (let i = 0; i < SENSORS; i++) {
+    const c = s.soilCycle.sensors[i];
+    const trend = c.count ? `${c.slope > 0 ? '+' : ''}${c.slope.toFixed(1)}` : '-';
+    html += `<tr><td style="color:${COLORS[i]}">${i}</td><td>${s.soilHumidityLast[i]}</td>` +
+            `<td>${s.soilHumidityMin[i]}</td><td>${s.soilHumidityMax[i]}</td>` +
+            `<td>${c.count ? c.mean.toFixed(0) : '-'}</td><td>${trend}</td></tr>`;
+  }
+  $('#soil tbody').innerHTML = html;
+}
+
+function renderChart(rollup) {
+  const canvas = $('#chart');
+  const ctx = canvas.getContext('2d');
+  ctx.clearRect(0, 0, canvas.width, canvas.height);
+
+  let t0 = Infinity, t1 = -Infinity, lo = Infinity, hi = -Infinity;
+  for (const s of rollup.sensors)
+    for (const [start, , , avg] of s.buckets) {
+      t0 = Math.min(t0, start); t1 = Math.max(t1, start);
+      lo = Math.min(lo, avg); hi = Math.max(hi, avg);
+    }
+  if (t0 >= t1)
+    return;
+  if (hi === lo)
+    hi = lo + 1;
+
+  const pad = 8;
+  const x = (t) => pad + (t - t0) / (t1 - t0) * (canvas.width - 2 * pad);
+  const y = (v) => canvas.height - pad - (v - lo) / (hi - lo) * (canvas.height - 2 * pad);
+  for (const s of rollup.sensors) {
+    ctx.strokeStyle = COLORS[s.sensor];
+    ctx.lineWidth = 2;
+    ctx.beginPath();
+    s.buckets.forEach(([start, , , avg], i) => i ? ctx.lineTo(x(start), y(avg)) : ctx.moveTo(x(start), y(avg)));
+    ctx.stroke();
+  }
+}
+
+function renderWatering(w) {
+  let text = w.pumpActive ? 'pump on' : 'idle';
+  if (w.job) {
+    const valves = w.valves.length ? `valve ${w.valves.join('+')}` : 'starting';
+    text = `job ${w.job} (${w.source}): ${valves}, ${w.elapsed}/${w.total} s`;
+  }
+  if (w.queued)
+    text += `, ${w.queued} queued`;
+  $('#watering').textContent = text;
+}
+
+function addEvent(text) {
+  const list = $('#events');
+  const item = document.createElement('li');
+  item.textContent = `${new Date().toLocaleTimeString()} ${text}`;
+  list.prepend(item);
+  while (list.children.length > MAX_EVENTS)
+    list.lastChild.remove();
+}
+
+async function refresh() {
+  try {
+    const [status, watering] = await Promise.all([getJson('/status'), getJson('/watering')]);
+    renderStatus(status);
+    renderWatering(watering);
+  } catch (e) {
+    addEvent(`refresh failed: ${e.message}`);
+  }
+}
+
+async function refreshChart() {
+  try {
+    renderChart(await getJson('/sensors/rollup?tier=hour'));
+  } catch (e) {
+    addEvent(`chart failed: ${e.message}`);
+  }
+}
+
+function connectEvents() {
+  const source = new EventSource('/events');
+  const badge = $('#conn');
+  source.onopen = () => { badge.textContent = 'live'; badge.classList.remove('off'); };
+  source.onerror = () => { badge.textContent = 'offline'; badge.classList.add('off'); };
+  source.addEventListener('log', (e) => {
+    const ev = JSON.parse(e.data);
+    addEvent(`${ev.eventType} ${ev.value}`);
+  });
+  source.addEventListener('pump', (e) => {
+    addEvent(JSON.parse(e.data).pumpActive ? 'pump on' : 'pump off');
+    refresh();
+  });
+}
+
+$('#water').addEventListener('submit', async (e) => {
+  e.preventDefault();
+  const params = new URLSearchParams(new FormData(e.target));
+  try {
+    const r = await getJson('/watering?' + params, { method: 'POST' });
+    addEvent(`job ${r.job} queued, ${r.total} s`);
+    refresh();
+  } catch (err) {
+    addEvent(`watering failed: ${err.message}`);
+  }
+});
+
+$('#cancel').addEventListener('click', async () => {
+  try {
+    const r = await getJson('/watering', { method: 'DELETE' });
+    addEvent(`${r.cancelled} job(s) cancelled`);
+    refresh();
+  } catch (err) {
+    addEvent(`cancel failed: ${err.message}`);
+  }
+});
+
+refresh();
+refreshChart();
+connectEvents();
+setInterval(refresh, 30000);
+setInterval(refreshChart, 10 * 60000);